@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/event.h>
+#include <sys/eventfd.h>
+#include <sys/queue.h>
+#include <sys/timerfd.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Every kevent filter is backed by a descriptor registered in the epoll
+ * set: the watched descriptor itself for EVFILT_READ, an eventfd for
+ * EVFILT_USER and a timerfd for EVFILT_TIMER.
+ */
+struct kq_filter {
+	LIST_ENTRY(kq_filter) link;
+	uintptr_t ident;
+	short filter;
+	unsigned short flags;
+	int fd;
+};
+
+/*
+ * epoll set does not tell when it is closed, so eventfds and timerfds of
+ * a closed kqueue are released when its descriptor number is handed out
+ * by kqueue() again.
+ */
+struct kq {
+	LIST_ENTRY(kq) link;
+	int epfd;
+	LIST_HEAD(, kq_filter) filters;
+};
+
+static LIST_HEAD(, kq) kqs = LIST_HEAD_INITIALIZER(kqs);
+static pthread_mutex_t kqs_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static struct kq *
+kq_find(int epfd)
+{
+	struct kq *kq;
+
+	LIST_FOREACH(kq, &kqs, link)
+		if (kq->epfd == epfd)
+			return (kq);
+
+	return (NULL);
+}
+
+static struct kq_filter *
+kq_find_filter(struct kq *kq, short filter, uintptr_t ident)
+{
+	struct kq_filter *kf;
+
+	LIST_FOREACH(kf, &kq->filters, link)
+		if (kf->filter == filter && kf->ident == ident)
+			return (kf);
+
+	return (NULL);
+}
+
+static void
+kq_delete_filter(struct kq *kq, struct kq_filter *kf)
+{
+
+	epoll_ctl(kq->epfd, EPOLL_CTL_DEL, kf->fd, NULL);
+	if (kf->filter != EVFILT_READ)
+		close(kf->fd);
+	LIST_REMOVE(kf, link);
+	free(kf);
+}
+
+/* Releases bookkeeping of kqueue whose epoll descriptor is closed */
+static void
+kq_free(struct kq *kq)
+{
+	struct kq_filter *kf;
+
+	while ((kf = LIST_FIRST(&kq->filters)) != NULL) {
+		if (kf->filter != EVFILT_READ)
+			close(kf->fd);
+		LIST_REMOVE(kf, link);
+		free(kf);
+	}
+	LIST_REMOVE(kq, link);
+	free(kq);
+}
+
+int
+kqueue(void)
+{
+	struct kq *kq, *old_kq;
+
+	kq = calloc(1, sizeof(struct kq));
+	if (kq == NULL)
+		return (-1);
+	kq->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (kq->epfd < 0) {
+		free(kq);
+		return (-1);
+	}
+	LIST_INIT(&kq->filters);
+
+	pthread_mutex_lock(&kqs_mtx);
+	old_kq = kq_find(kq->epfd);
+	if (old_kq != NULL)
+		kq_free(old_kq);
+	LIST_INSERT_HEAD(&kqs, kq, link);
+	pthread_mutex_unlock(&kqs_mtx);
+
+	return (kq->epfd);
+}
+
+static int
+kq_arm_timer(int fd, int64_t msec, bool oneshot)
+{
+	struct itimerspec its;
+
+	its.it_value.tv_sec = msec / 1000;
+	its.it_value.tv_nsec = (msec % 1000) * 1000000;
+	if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+		its.it_value.tv_nsec = 1;
+	its.it_interval = oneshot ?
+	    (struct timespec) { 0, 0 } : its.it_value;
+
+	return (timerfd_settime(fd, 0, &its, NULL));
+}
+
+static int
+kq_add_filter(struct kq *kq, const struct kevent *kev)
+{
+	struct kq_filter *kf;
+	struct epoll_event ee;
+
+	ee.events = EPOLLIN;
+	kf = kq_find_filter(kq, kev->filter, kev->ident);
+	if (kf != NULL) {
+		kf->flags = kev->flags;
+		if (kf->filter == EVFILT_TIMER)
+			return (kq_arm_timer(kf->fd, kev->data,
+			    kev->flags & EV_ONESHOT));
+		/* Closed descriptor has left epoll set, re-add it */
+		ee.data.ptr = kf;
+		if (kf->filter == EVFILT_READ &&
+		    epoll_ctl(kq->epfd, EPOLL_CTL_ADD, kf->fd, &ee) < 0 &&
+		    errno != EEXIST)
+			return (-1);
+		return (0);
+	}
+
+	kf = calloc(1, sizeof(struct kq_filter));
+	if (kf == NULL)
+		return (-1);
+	kf->ident = kev->ident;
+	kf->filter = kev->filter;
+	kf->flags = kev->flags;
+
+	switch (kev->filter) {
+	case EVFILT_READ:
+		kf->fd = kev->ident;
+		break;
+	case EVFILT_USER:
+		kf->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		break;
+	case EVFILT_TIMER:
+		kf->fd = timerfd_create(CLOCK_MONOTONIC,
+		    TFD_CLOEXEC | TFD_NONBLOCK);
+		if (kf->fd >= 0 && kq_arm_timer(kf->fd, kev->data,
+		    kev->flags & EV_ONESHOT) < 0) {
+			close(kf->fd);
+			kf->fd = -1;
+		}
+		break;
+	default:
+		errno = EINVAL;
+		kf->fd = -1;
+		break;
+	}
+	if (kf->fd < 0) {
+		free(kf);
+		return (-1);
+	}
+
+	ee.data.ptr = kf;
+	if (epoll_ctl(kq->epfd, EPOLL_CTL_ADD, kf->fd, &ee) < 0) {
+		if (kf->filter != EVFILT_READ)
+			close(kf->fd);
+		free(kf);
+		return (-1);
+	}
+
+	LIST_INSERT_HEAD(&kq->filters, kf, link);
+	return (0);
+}
+
+static int
+kq_apply(struct kq *kq, const struct kevent *kev)
+{
+	struct kq_filter *kf;
+	uint64_t one = 1;
+
+	if (kev->flags & EV_ADD && kq_add_filter(kq, kev) < 0)
+		return (-1);
+
+	kf = kq_find_filter(kq, kev->filter, kev->ident);
+	if (kf == NULL) {
+		errno = ENOENT;
+		return (-1);
+	}
+	if (kev->flags & EV_DELETE) {
+		kq_delete_filter(kq, kf);
+		return (0);
+	}
+	if (kf->filter == EVFILT_USER && kev->fflags & NOTE_TRIGGER &&
+	    write(kf->fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		return (-1);
+
+	return (0);
+}
+
+/* Converts fired epoll event to kevent. Returns false if it is stale */
+static bool
+kq_collect(struct kq *kq, struct epoll_event *ee, struct kevent *kev)
+{
+	struct kq_filter *kf;
+	uint64_t count;
+
+	LIST_FOREACH(kf, &kq->filters, link)
+		if (kf == ee->data.ptr)
+			break;
+	if (kf == NULL)
+		return (false);
+
+	switch (kf->filter) {
+	case EVFILT_USER:
+		if (kf->flags & EV_CLEAR &&
+		    read(kf->fd, &count, sizeof(count)) < 0 && errno == EAGAIN)
+			return (false);
+		break;
+	case EVFILT_TIMER:
+		if (read(kf->fd, &count, sizeof(count)) < 0 && errno == EAGAIN)
+			return (false);
+		break;
+	}
+
+	EV_SET(kev, kf->ident, kf->filter, 0, 0, 0, NULL);
+	if (kf->filter == EVFILT_TIMER && kf->flags & EV_ONESHOT)
+		kq_delete_filter(kq, kf);
+	return (true);
+}
+
+int
+kevent(int epfd, const struct kevent *changelist, int nchanges,
+    struct kevent *eventlist, int nevents, const struct timespec *timeout)
+{
+	struct epoll_event ee[16];
+	struct kq *kq;
+	int i, n, ret, msec;
+
+	pthread_mutex_lock(&kqs_mtx);
+	kq = kq_find(epfd);
+	if (kq == NULL) {
+		pthread_mutex_unlock(&kqs_mtx);
+		errno = EBADF;
+		return (-1);
+	}
+	for (i = 0; i < nchanges; i++) {
+		if (kq_apply(kq, &changelist[i]) < 0) {
+			pthread_mutex_unlock(&kqs_mtx);
+			return (-1);
+		}
+	}
+	pthread_mutex_unlock(&kqs_mtx);
+
+	if (nevents == 0)
+		return (0);
+
+	msec = timeout == NULL ? -1 :
+	    timeout->tv_sec * 1000 + (timeout->tv_nsec + 999999) / 1000000;
+	if (nevents > (int)(sizeof(ee) / sizeof(ee[0])))
+		nevents = sizeof(ee) / sizeof(ee[0]);
+
+	/* Events consumed by another waiter are not reported */
+	do {
+		n = epoll_wait(epfd, ee, nevents, msec);
+		if (n <= 0)
+			return (n);
+
+		ret = 0;
+		pthread_mutex_lock(&kqs_mtx);
+		kq = kq_find(epfd);
+		for (i = 0; kq != NULL && i < n; i++)
+			if (kq_collect(kq, &ee[i], &eventlist[ret]))
+				ret++;
+		pthread_mutex_unlock(&kqs_mtx);
+	} while (ret == 0 && msec < 0);
+
+	return (ret);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * kqueue(2) subset emulated with epoll for hosts that lack it. Only
+ * EVFILT_READ, one-shot EVFILT_TIMER and EVFILT_USER are supported, that
+ * is what devd connection needs. Descriptor returned by kqueue() is an
+ * epoll descriptor, so it can be polled by the application.
+ */
+
+#ifndef	_SYS_EVENT_H_
+#define	_SYS_EVENT_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#define	EVFILT_READ		(-1)
+#define	EVFILT_TIMER		(-7)
+#define	EVFILT_USER		(-11)
+
+#define	EV_ADD			0x0001
+#define	EV_DELETE		0x0002
+#define	EV_ENABLE		0x0004
+#define	EV_ONESHOT		0x0010
+#define	EV_CLEAR		0x0020
+
+#define	NOTE_TRIGGER		0x01000000
+
+struct kevent {
+	uintptr_t ident;
+	short filter;
+	unsigned short flags;
+	unsigned int fflags;
+	int64_t data;
+	void *udata;
+};
+
+#define	EV_SET(kevp, a, b, c, d, e, f) do {				\
+	struct kevent *kevp_ = (kevp);					\
+	kevp_->ident = (a);						\
+	kevp_->filter = (b);						\
+	kevp_->flags = (c);						\
+	kevp_->fflags = (d);						\
+	kevp_->data = (e);						\
+	kevp_->udata = (f);						\
+} while (0)
+
+int kqueue(void);
+int kevent(int kq, const struct kevent *changelist, int nchanges,
+    struct kevent *eventlist, int nevents, const struct timespec *timeout);
+
+#endif	/* _SYS_EVENT_H_ */
@@ -19,6 +19,8 @@ void udev_unref(struct udev *udev);
 const char *udev_get_dev_path(struct udev *udev);
 void *udev_get_userdata(struct udev *udev);
 void udev_set_userdata(struct udev *udev, void *userdata);
+int udev_set_device_cache_size(struct udev *udev, int size);
+void udev_trim_device_cache(struct udev *udev);
 
 struct udev_device *udev_device_new_from_syspath(struct udev *udev,
     const char *syspath);
@@ -103,10 +105,17 @@ void udev_monitor_unref(struct udev_monitor *udev_monitor);
 int udev_monitor_filter_add_match_subsystem_devtype(
     struct udev_monitor *udev_monitor, const char *subsystem,
     const char *devtype);
+int udev_monitor_set_receive_buffer_size(struct udev_monitor *udev_monitor,
+    int size);
+int udev_monitor_set_threadless(struct udev_monitor *udev_monitor,
+    int threadless);
 int udev_monitor_enable_receiving(struct udev_monitor *udev_monitor);
 int udev_monitor_get_fd(struct udev_monitor *udev_monitor);
 struct udev_device *udev_monitor_receive_device(
     struct udev_monitor *udev_monitor);
+#define	UDEV_MONITOR_NONBLOCK	0x01
+int udev_monitor_receive_devices(struct udev_monitor *udev_monitor,
+    struct udev_device **udev_devices, int count, int flags);
 const char *udev_device_get_action(struct udev_device *udev_device);
 struct udev *udev_monitor_get_udev(struct udev_monitor *udev_monitor);
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Replays a devd stream through both socket types: notices the monitor
+ * filters out, closed by one it delivers. Reports lines per second and
+ * lines per read(2) of the monitor thread where the host accounts them.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+#define	BENCH_BATCH	256	/* lines per write to stream socket */
+#define	BENCH_LINES	(BENCH_BATCH * 800)
+
+static void
+bench_socket(struct udev *udev, int type, const char *name)
+{
+	static char batch[BENCH_BATCH * 64];
+	const char *msg = NOTICE("CREATE", "dri/card0");
+	struct pollfd pfd;
+	struct udev_monitor *um;
+	struct udev_device *ud;
+	size_t len;
+	long reads;
+	double start, elapsed;
+	int lfd, fd, i;
+
+	lfd = devd_listen(type);
+	um = udev_monitor_new_from_netlink(udev, "udev");
+	CHECK(um != NULL);
+	CHECK(udev_monitor_filter_add_match_subsystem_devtype(um, "input",
+	    NULL) == 0);
+	CHECK(udev_monitor_enable_receiving(um) == 0);
+	fd = accept(lfd, NULL, NULL);
+	CHECK(fd >= 0);
+
+	len = strlen(msg);
+	CHECK(len * BENCH_BATCH < sizeof(batch));
+	for (i = 0; i < BENCH_BATCH; i++)
+		memcpy(batch + i * len, msg, len);
+
+	reads = bench_read_calls();
+	start = bench_now();
+	if (type == SOCK_STREAM) {
+		for (i = 0; i < BENCH_LINES; i += BENCH_BATCH)
+			CHECK(write(fd, batch, len * BENCH_BATCH) ==
+			    (ssize_t)(len * BENCH_BATCH));
+	} else {
+		for (i = 0; i < BENCH_LINES; i++)
+			devd_send(fd, msg);
+	}
+	devd_send(fd, NOTICE("CREATE", "input/event1"));
+
+	pfd = (struct pollfd) {
+		.fd = udev_monitor_get_fd(um),
+		.events = POLLIN,
+	};
+	do {
+		CHECK(poll(&pfd, 1, 10000) == 1);
+		ud = udev_monitor_receive_device(um);
+	} while (ud == NULL);
+	elapsed = bench_now() - start;
+	if (reads >= 0)
+		reads = bench_read_calls() - reads;
+	CHECK(STREQ(udev_device_get_syspath(ud), "/dev/input/event1"));
+	udev_device_unref(ud);
+
+	printf("%s: %d lines in %.3f s, %.0f lines/s", name, i + 1, elapsed,
+	    (i + 1) / elapsed);
+	if (reads > 0)
+		printf(", %.1f lines per read", (double)(i + 1) / reads);
+	printf("\n");
+
+	udev_monitor_unref(um);
+	close(fd);
+	close(lfd);
+	devd_unlink();
+}
+
+int
+main(void)
+{
+	struct udev *udev;
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+	bench_socket(udev, SOCK_STREAM, "stream");
+	bench_socket(udev, SOCK_SEQPACKET, "seqpacket");
+	udev_unref(udev);
+
+	return (0);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Times udev_device_new_from_syspath() on each device of
+ * tests/evdev.fixture. Every probe reads capability bitmaps of the unit
+ * and classifies them, as device cache is disabled.
+ */
+
+#include <stdio.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+#define	BENCH_PROBES	50000
+
+static const struct {
+	const char *syspath;
+	const char *type;
+} corpus[] = {
+	{ "/dev/input/event0", "ID_INPUT_KEYBOARD" },
+	{ "/dev/input/event1", "ID_INPUT_MOUSE" },
+	{ "/dev/input/event2", "ID_INPUT_TOUCHPAD" },
+	{ "/dev/input/event3", "ID_INPUT_MOUSE" },
+	{ "/dev/input/event4", "ID_INPUT_TOUCHSCREEN" },
+	{ "/dev/input/event5", "ID_INPUT_TABLET" },
+	{ "/dev/input/event6", "ID_INPUT_JOYSTICK" },
+	{ "/dev/input/event7", "ID_INPUT_ACCELEROMETER" },
+	{ "/dev/input/event8", "ID_INPUT_KEYBOARD" },
+	{ "/dev/input/event9", "ID_INPUT_SWITCH" },
+};
+
+static double
+bench_probe(struct udev *udev, const char *syspath, const char *type)
+{
+	struct udev_device *ud;
+	double start;
+	int i;
+
+	start = bench_now();
+	for (i = 0; i < BENCH_PROBES; i++) {
+		ud = udev_device_new_from_syspath(udev, syspath);
+		CHECK(ud != NULL);
+		CHECK(STREQ(udev_device_get_property_value(ud, type), "1"));
+		udev_device_unref(ud);
+	}
+	return (bench_now() - start);
+}
+
+int
+main(void)
+{
+	struct udev *udev;
+	double elapsed, total;
+	size_t i;
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+
+	total = 0;
+	for (i = 0; i < nitems(corpus); i++) {
+		elapsed = bench_probe(udev, corpus[i].syspath, corpus[i].type);
+		printf("%s %s: %.2f us per probe\n", corpus[i].syspath,
+		    corpus[i].type, elapsed / BENCH_PROBES * 1e6);
+		total += elapsed;
+	}
+	printf("corpus: %.2f us per probe\n",
+	    total / (BENCH_PROBES * nitems(corpus)) * 1e6);
+
+	udev_unref(udev);
+	return (0);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Scans devices of tests/devices.fixture with dozens of filters of one
+ * kind that match nothing and reports time per scan next to the scan
+ * with a single such filter.
+ */
+
+#include <stdio.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+#define	BENCH_SCANS	50000
+#define	BENCH_FILTERS	48
+
+static void
+add_sysname_literal(struct udev_enumerate *ue)
+{
+
+	CHECK(udev_enumerate_add_match_sysname(ue, "mouse0") == 0);
+}
+
+static void
+add_sysname_literals(struct udev_enumerate *ue)
+{
+	char sysname[32];
+	int i;
+
+	for (i = 0; i < BENCH_FILTERS; i++) {
+		snprintf(sysname, sizeof(sysname), "mouse%d", i);
+		CHECK(udev_enumerate_add_match_sysname(ue, sysname) == 0);
+	}
+}
+
+static void
+add_sysname_globs(struct udev_enumerate *ue)
+{
+	char sysname[32];
+	int i;
+
+	for (i = 0; i < BENCH_FILTERS; i++) {
+		snprintf(sysname, sizeof(sysname), "mouse%d*", i);
+		CHECK(udev_enumerate_add_match_sysname(ue, sysname) == 0);
+	}
+}
+
+static void
+add_subsystems(struct udev_enumerate *ue)
+{
+	char subsystem[32];
+	int i;
+
+	for (i = 0; i < BENCH_FILTERS; i++) {
+		snprintf(subsystem, sizeof(subsystem), "mouse%d*", i);
+		CHECK(udev_enumerate_add_match_subsystem(ue, subsystem) == 0);
+	}
+}
+
+static void
+add_properties(struct udev_enumerate *ue)
+{
+	char value[32];
+	int i;
+
+	for (i = 0; i < BENCH_FILTERS; i++) {
+		snprintf(value, sizeof(value), "%d", i + 2);
+		CHECK(udev_enumerate_add_match_property(ue, "ID_INPUT_MOUSE",
+		    value) == 0);	/* value is always 1 */
+	}
+}
+
+static const struct bench_filter {
+	const char *name;
+	void (*add)(struct udev_enumerate *ue);
+} filters[] = {
+	{ "1 literal sysname", add_sysname_literal },
+	{ "literal sysnames", add_sysname_literals },
+	{ "sysname globs", add_sysname_globs },
+	{ "subsystems", add_subsystems },
+	{ "literal properties", add_properties },
+};
+
+int
+main(void)
+{
+	struct udev *udev;
+	struct udev_enumerate *ue;
+	double start, elapsed, base;
+	size_t i;
+	int j;
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+
+	base = 0;
+	for (i = 0; i < nitems(filters); i++) {
+		ue = udev_enumerate_new(udev);
+		CHECK(ue != NULL);
+		filters[i].add(ue);
+		start = bench_now();
+		for (j = 0; j < BENCH_SCANS; j++)
+			CHECK(udev_enumerate_scan_devices(ue) == 0);
+		elapsed = (bench_now() - start) / BENCH_SCANS * 1e6;
+		CHECK(udev_enumerate_get_list_entry(ue) == NULL);
+		udev_enumerate_unref(ue);
+
+		if (i == 0) {
+			base = elapsed;
+			printf("%s: %.2f us per scan\n", filters[i].name,
+			    elapsed);
+		} else
+			printf("%d %s: %.2f us per scan, %+.2f us over 1\n",
+			    BENCH_FILTERS, filters[i].name, elapsed,
+			    elapsed - base);
+	}
+
+	udev_unref(udev);
+	return (0);
+}
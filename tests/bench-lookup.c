@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Times udev_device_get_sysattr_value() on a device carrying a growing
+ * number of sysattrs set by the application, and
+ * udev_device_get_property_value() on properties a probe has set.
+ */
+
+#include <stdio.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+#define	BENCH_LOOKUPS	2000000
+#define	BENCH_ATTRS_MAX	4096
+
+static char keys[BENCH_ATTRS_MAX][16];
+
+static void
+bench_sysattrs(struct udev *udev, int count)
+{
+	struct udev_device *ud;
+	double start, elapsed;
+	int i;
+
+	/* Device stays private as the device cache is disabled */
+	ud = udev_device_new_from_syspath(udev, "/dev/input/event1");
+	CHECK(ud != NULL);
+	for (i = 0; i < count; i++)
+		CHECK(udev_device_set_sysattr_value(ud, keys[i], "1") == 0);
+
+	start = bench_now();
+	for (i = 0; i < BENCH_LOOKUPS; i++)
+		CHECK(udev_device_get_sysattr_value(ud,
+		    keys[(i * 7919u) % count]) != NULL);
+	elapsed = bench_now() - start;
+	printf("%d sysattrs: %.1f ns per lookup\n", count,
+	    elapsed / BENCH_LOOKUPS * 1e9);
+
+	udev_device_unref(ud);
+}
+
+static void
+bench_properties(struct udev *udev)
+{
+	static const char *properties[] = { "ID_INPUT", "ID_INPUT_MOUSE" };
+	struct udev_device *ud;
+	double start, elapsed;
+	int i;
+
+	ud = udev_device_new_from_syspath(udev, "/dev/input/event1");
+	CHECK(ud != NULL);
+
+	start = bench_now();
+	for (i = 0; i < BENCH_LOOKUPS; i++)
+		CHECK(udev_device_get_property_value(ud,
+		    properties[i % nitems(properties)]) != NULL);
+	elapsed = bench_now() - start;
+	printf("probed properties: %.1f ns per lookup\n",
+	    elapsed / BENCH_LOOKUPS * 1e9);
+
+	udev_device_unref(ud);
+}
+
+int
+main(void)
+{
+	struct udev *udev;
+	int count, i;
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+	for (i = 0; i < BENCH_ATTRS_MAX; i++)
+		snprintf(keys[i], sizeof(keys[i]), "attr%04d", i);
+
+	bench_properties(udev);
+	for (count = 8; count <= BENCH_ATTRS_MAX; count *= 8)
+		bench_sysattrs(udev, count);
+
+	udev_unref(udev);
+	return (0);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Storms udev_monitor with bursts of delivered events and drains each
+ * burst before the next one, so the ring never overflows. Reports events
+ * per second and fd wakeups per burst for threaded monitor read one or
+ * many devices at a time and for threadless monitor.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+#define	BENCH_BURST	512	/* half of default ring size */
+#define	BENCH_BURSTS	200
+#define	BENCH_BATCH	64	/* devices per udev_monitor_receive_devices */
+
+/* Receives queued devices without blocking. Returns 0 if none is queued */
+static int
+receive(struct udev_monitor *um, struct pollfd *pfd,
+    struct udev_device **devices, int batch)
+{
+	int n;
+
+	/* Fd stays readable while devices are queued */
+	if (batch == 1) {
+		if (poll(pfd, 1, 0) != 1)
+			return (0);
+		devices[0] = udev_monitor_receive_device(um);
+		CHECK(devices[0] != NULL);
+		return (1);
+	}
+	n = udev_monitor_receive_devices(um, devices, batch,
+	    UDEV_MONITOR_NONBLOCK);
+	CHECK(n >= 0);
+	return (n);
+}
+
+static void
+bench_monitor(struct udev *udev, bool threadless, int batch,
+    const char *name)
+{
+	static char burst[BENCH_BURST * 64];
+	const char *msg = NOTICE("CREATE", "input/event1");
+	struct udev_device *devices[BENCH_BATCH];
+	struct pollfd pfd;
+	struct udev_monitor *um;
+	size_t len;
+	double start, elapsed;
+	long wakeups;
+	int lfd, fd, i, n, received;
+
+	lfd = devd_listen(SOCK_STREAM);
+	um = udev_monitor_new_from_netlink(udev, "udev");
+	CHECK(um != NULL);
+	CHECK(udev_monitor_filter_add_match_subsystem_devtype(um, "input",
+	    NULL) == 0);
+	CHECK(udev_monitor_set_threadless(um, threadless) == 0);
+	CHECK(udev_monitor_enable_receiving(um) == 0);
+	fd = accept(lfd, NULL, NULL);
+	CHECK(fd >= 0);
+
+	len = strlen(msg);
+	CHECK(len * BENCH_BURST < sizeof(burst));
+	for (i = 0; i < BENCH_BURST; i++)
+		memcpy(burst + i * len, msg, len);
+
+	pfd = (struct pollfd) {
+		.fd = udev_monitor_get_fd(um),
+		.events = POLLIN,
+	};
+	wakeups = 0;
+	start = bench_now();
+	for (i = 0; i < BENCH_BURSTS; i++) {
+		CHECK(write(fd, burst, len * BENCH_BURST) ==
+		    (ssize_t)(len * BENCH_BURST));
+		/* Each wakeup drains whatever is queued */
+		for (received = 0; received < BENCH_BURST;) {
+			CHECK(poll(&pfd, 1, 10000) == 1);
+			wakeups++;
+			while ((n = receive(um, &pfd, devices, batch)) > 0) {
+				received += n;
+				while (n > 0)
+					udev_device_unref(devices[--n]);
+			}
+		}
+	}
+	elapsed = bench_now() - start;
+
+	printf("%s: %d events in %.3f s, %.0f events/s, "
+	    "%.1f wakeups per burst of %d\n", name, BENCH_BURST * BENCH_BURSTS,
+	    elapsed, BENCH_BURST * BENCH_BURSTS / elapsed,
+	    (double)wakeups / BENCH_BURSTS, BENCH_BURST);
+
+	udev_monitor_unref(um);
+	close(fd);
+	close(lfd);
+	devd_unlink();
+}
+
+int
+main(void)
+{
+	struct udev *udev;
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+	bench_monitor(udev, false, 1, "threaded, one at a time");
+	bench_monitor(udev, false, BENCH_BATCH, "threaded, batched");
+	bench_monitor(udev, true, BENCH_BATCH, "threadless, batched");
+	udev_unref(udev);
+
+	return (0);
+}
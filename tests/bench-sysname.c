@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Compares udev_device_new_from_subsystem_sysname() with the fallback
+ * applications use without it: scanning the subsystem and searching the
+ * list for the sysname.
+ */
+
+#include <stdio.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+#define	BENCH_LOOKUPS	50000
+
+static struct udev_device *
+lookup_direct(struct udev *udev, const char *subsystem, const char *sysname)
+{
+
+	return (udev_device_new_from_subsystem_sysname(udev, subsystem,
+	    sysname));
+}
+
+static struct udev_device *
+lookup_scan(struct udev *udev, const char *subsystem, const char *sysname)
+{
+	struct udev_enumerate *ue;
+	struct udev_list_entry *ule;
+	struct udev_device *ud = NULL;
+	const char *syspath, *name;
+
+	ue = udev_enumerate_new(udev);
+	CHECK(ue != NULL);
+	CHECK(udev_enumerate_add_match_subsystem(ue, subsystem) == 0);
+	CHECK(udev_enumerate_scan_devices(ue) == 0);
+	udev_list_entry_foreach(ule, udev_enumerate_get_list_entry(ue)) {
+		syspath = udev_list_entry_get_name(ule);
+		name = strrchr(syspath, '/');
+		if (name != NULL && strcmp(name + 1, sysname) == 0) {
+			ud = udev_device_new_from_syspath(udev, syspath);
+			break;
+		}
+	}
+	udev_enumerate_unref(ue);
+
+	return (ud);
+}
+
+static double
+bench(struct udev *udev, const char *subsystem, const char *sysname,
+    struct udev_device *(*lookup)(struct udev *, const char *,
+    const char *))
+{
+	struct udev_device *ud;
+	double start;
+	int i;
+
+	start = bench_now();
+	for (i = 0; i < BENCH_LOOKUPS; i++) {
+		ud = lookup(udev, subsystem, sysname);
+		CHECK(ud != NULL);
+		udev_device_unref(ud);
+	}
+
+	return ((bench_now() - start) / BENCH_LOOKUPS * 1e6);
+}
+
+int
+main(void)
+{
+	static const char *devices[][2] = {
+		{ "drm", "card0" },
+		{ "input", "event2" },
+		{ "input", "joy0" },
+	};
+	struct udev *udev;
+	double direct, scan;
+	size_t i;
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+	for (i = 0; i < nitems(devices); i++) {
+		direct = bench(udev, devices[i][0], devices[i][1],
+		    lookup_direct);
+		scan = bench(udev, devices[i][0], devices[i][1], lookup_scan);
+		printf("%s %s: %.2f us direct, %.2f us scan and search\n",
+		    devices[i][0], devices[i][1], direct, scan);
+	}
+
+	udev_unref(udev);
+	return (0);
+}
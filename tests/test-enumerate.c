@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Enumerates devices of tests/devices.fixture and checks what probing
+ * made of them.
+ */
+
+#include "libudev.h"
+#include "test-utils.h"
+
+/* Scans devices and checks the list equals NULL terminated syspaths */
+static void
+check_scan(struct udev_enumerate *ue, const char * const *syspaths)
+{
+	struct udev_list_entry *ule;
+
+	CHECK(udev_enumerate_scan_devices(ue) == 0);
+	udev_list_entry_foreach(ule, udev_enumerate_get_list_entry(ue)) {
+		CHECK(*syspaths != NULL);
+		CHECK(STREQ(udev_list_entry_get_name(ule), *syspaths));
+		syspaths++;
+	}
+	CHECK(*syspaths == NULL);
+}
+
+static void
+check_input(struct udev *udev, const char *syspath, const char *type,
+    const char *name, const char *product)
+{
+	struct udev_device *ud, *parent;
+
+	ud = udev_device_new_from_syspath(udev, syspath);
+	CHECK(ud != NULL);
+	CHECK(STREQ(udev_device_get_syspath(ud), syspath));
+	CHECK(STREQ(udev_device_get_devnode(ud), syspath));
+	CHECK(STREQ(udev_device_get_subsystem(ud), "input"));
+	CHECK(STREQ(udev_device_get_property_value(ud, "ID_INPUT"), "1"));
+	CHECK(STREQ(udev_device_get_property_value(ud, type), "1"));
+
+	parent = udev_device_get_parent(ud);
+	CHECK(parent != NULL);
+	CHECK(STREQ(udev_device_get_property_value(parent, "NAME"), name));
+	CHECK(STREQ(udev_device_get_sysattr_value(parent, "name"), name));
+	CHECK(STREQ(udev_device_get_property_value(parent, "PRODUCT"),
+	    product));
+	udev_device_unref(ud);
+}
+
+int
+main(void)
+{
+	static const char * const all[] = { "/dev/dri/card0",
+	    "/dev/input/event0", "/dev/input/event1", "/dev/input/event2",
+	    "/dev/joy0", NULL };
+	static const char * const input[] = { "/dev/input/event0",
+	    "/dev/input/event1", "/dev/input/event2", "/dev/joy0", NULL };
+	static const char * const drm[] = { "/dev/dri/card0", NULL };
+	static const char * const mice[] = { "/dev/input/event1",
+	    "/dev/input/event2", NULL };
+	static const char * const event1[] = { "/dev/input/event1", NULL };
+	struct udev *udev;
+	struct udev_enumerate *ue;
+	struct udev_device *ud, *parent;
+	int i;
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+
+	/* atkbd0 and ums0 are hidden behind evdev */
+	ue = udev_enumerate_new(udev);
+	CHECK(ue != NULL);
+	check_scan(ue, all);
+	udev_enumerate_unref(ue);
+
+	ue = udev_enumerate_new(udev);
+	CHECK(udev_enumerate_add_match_subsystem(ue, "input") == 0);
+	check_scan(ue, input);
+	udev_enumerate_unref(ue);
+
+	/* Positive filters are ORed, negative ones veto what they pass */
+	ue = udev_enumerate_new(udev);
+	CHECK(udev_enumerate_add_match_subsystem(ue, "*") == 0);
+	CHECK(udev_enumerate_add_nomatch_subsystem(ue, "input") == 0);
+	check_scan(ue, drm);
+	udev_enumerate_unref(ue);
+
+	ue = udev_enumerate_new(udev);
+	CHECK(udev_enumerate_add_match_property(ue, "ID_INPUT_MOUSE",
+	    "1") == 0);
+	check_scan(ue, mice);
+	/* Device probed by the scan is taken over, the other one dropped */
+	ud = udev_device_new_from_syspath(udev, "/dev/input/event1");
+	CHECK(ud != NULL);
+	CHECK(STREQ(udev_device_get_property_value(ud, "ID_INPUT_MOUSE"),
+	    "1"));
+	udev_enumerate_unref(ue);
+	CHECK(STREQ(udev_device_get_sysname(ud), "event1"));
+	udev_device_unref(ud);
+
+	ue = udev_enumerate_new(udev);
+	CHECK(udev_enumerate_add_match_sysname(ue, "event1") == 0);
+	check_scan(ue, event1);
+	udev_enumerate_unref(ue);
+
+	check_input(udev, "/dev/input/event0", "ID_INPUT_KEYBOARD",
+	    "AT keyboard", "11/1/1/ab00");
+	check_input(udev, "/dev/input/event1", "ID_INPUT_MOUSE",
+	    "Logitech USB Optical Mouse", "3/46d/c077/111");
+	check_input(udev, "/dev/input/event2", "ID_INPUT_TOUCHPAD",
+	    "SYNA2B2C:01 06CB:7F27 TouchPad", "18/6cb/7f27/100");
+	check_input(udev, "/dev/joy0", "ID_INPUT_JOYSTICK",
+	    "Generic PC joystick", "3/45e/7/0");
+
+	ud = udev_device_new_from_subsystem_sysname(udev, "drm", "card0");
+	CHECK(ud != NULL);
+	CHECK(STREQ(udev_device_get_syspath(ud), "/dev/dri/card0"));
+	CHECK(STREQ(udev_device_get_property_value(ud, "HOTPLUG"), "1"));
+	udev_device_unref(ud);
+	CHECK(udev_device_new_from_subsystem_sysname(udev, "input",
+	    "atkbd0") == NULL);
+
+	/* Second lookup is served from devnum index filled by the first */
+	for (i = 0; i < 2; i++) {
+		ud = udev_device_new_from_devnum(udev, 'c', 0x70);
+		CHECK(ud != NULL);
+		CHECK(STREQ(udev_device_get_syspath(ud), "/dev/dri/card0"));
+		CHECK(udev_device_get_devnum(ud) == 0x70);
+		CHECK(STREQ(udev_device_get_property_value(ud, "HOTPLUG"),
+		    "1"));
+		parent = udev_device_get_parent(ud);
+		CHECK(parent != NULL);
+		CHECK(STREQ(udev_device_get_property_value(parent, "PCI_ID"),
+		    "8086:5917"));
+		CHECK(STREQ(udev_device_get_property_value(parent, "NAME"),
+		    "Intel UHD Graphics 620"));
+		udev_device_unref(ud);
+	}
+	CHECK(udev_device_new_from_devnum(udev, 'c', 0x99) == NULL);
+
+	udev_unref(udev);
+	return (0);
+}
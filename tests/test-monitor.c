@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Feeds devd notifications for devices of tests/devices.fixture through
+ * a socket standing in for devd and checks what monitors deliver.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <unistd.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+static void
+check_device(struct udev_device *ud, const char *action,
+    const char *syspath)
+{
+
+	CHECK(ud != NULL);
+	CHECK(STREQ(udev_device_get_action(ud), action));
+	CHECK(STREQ(udev_device_get_syspath(ud), syspath));
+	CHECK(STREQ(udev_device_get_subsystem(ud), "input"));
+}
+
+int
+main(void)
+{
+	struct udev *udev;
+	struct udev_monitor *um;
+	struct udev_device *ud;
+	int lfd, fd;
+
+	alarm(20);
+	lfd = devd_listen(SOCK_SEQPACKET);
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+	um = udev_monitor_new_from_netlink(udev, "udev");
+	CHECK(um != NULL);
+	CHECK(udev_monitor_filter_add_match_subsystem_devtype(um, "input",
+	    NULL) == 0);
+	CHECK(udev_monitor_enable_receiving(um) == 0);
+	fd = accept(lfd, NULL, NULL);
+	CHECK(fd >= 0);
+
+	/* drm device is filtered out, ums0 is hidden behind evdev */
+	devd_send(fd, NOTICE("CREATE", "dri/card0"));
+	devd_send(fd, NOTICE("CREATE", "ums0"));
+	devd_send(fd, NOTICE("CREATE", "input/event1"));
+	ud = udev_monitor_receive_device(um);
+	check_device(ud, "add", "/dev/input/event1");
+	CHECK(STREQ(udev_device_get_property_value(ud, "ID_INPUT_MOUSE"),
+	    "1"));
+	udev_device_unref(ud);
+
+	devd_send(fd, NOTICE("DESTROY", "input/event1"));
+	ud = udev_monitor_receive_device(um);
+	check_device(ud, "remove", "/dev/input/event1");
+	udev_device_unref(ud);
+
+	devd_send(fd, NOTICE("CREATE", "joy0"));
+	ud = udev_monitor_receive_device(um);
+	check_device(ud, "add", "/dev/joy0");
+	CHECK(STREQ(udev_device_get_property_value(ud,
+	    "ID_INPUT_JOYSTICK"), "1"));
+	udev_device_unref(ud);
+
+	udev_monitor_unref(um);
+	close(fd);
+	close(lfd);
+	devd_unlink();
+	udev_unref(udev);
+	return (0);
+}
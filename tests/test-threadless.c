@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Drives threadless udev_monitor through both devd socket types: lines
+ * split across writes, ring overflow held back in the socket and devd
+ * restart.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+#define	RING_SLOTS	16	/* ring size for zero receive buffer size */
+
+static const char *syspaths[] = {
+	"/dev/input/event0", "/dev/input/event1", "/dev/input/event2",
+};
+
+static const char *notices[] = {
+	NOTICE("CREATE", "input/event0"),
+	NOTICE("CREATE", "input/event1"),
+	NOTICE("CREATE", "input/event2"),
+};
+
+static struct udev_monitor *
+monitor_new(struct udev *udev)
+{
+	struct udev_monitor *um;
+
+	um = udev_monitor_new_from_netlink(udev, "udev");
+	CHECK(um != NULL);
+	CHECK(udev_monitor_set_threadless(um, 1) == 0);
+	CHECK(udev_monitor_set_receive_buffer_size(um, 0) == 0);
+	CHECK(udev_monitor_enable_receiving(um) == 0);
+
+	return (um);
+}
+
+static bool
+wait_fd(int fd, int msec)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return (poll(&pfd, 1, msec) == 1);
+}
+
+/* Receives up to count devices checking they follow notices[] order */
+static int
+receive(struct udev_monitor *um, int count, int *seq)
+{
+	struct udev_device *devices[RING_SLOTS * 2];
+	int i, n;
+
+	n = udev_monitor_receive_devices(um, devices, count,
+	    UDEV_MONITOR_NONBLOCK);
+	CHECK(n >= 0 && n <= count);
+	for (i = 0; i < n; i++) {
+		CHECK(STREQ(udev_device_get_action(devices[i]), "add"));
+		CHECK(STREQ(udev_device_get_syspath(devices[i]),
+		    syspaths[*seq % nitems(syspaths)]));
+		udev_device_unref(devices[i]);
+		(*seq)++;
+	}
+
+	return (n);
+}
+
+static void
+test_socket(struct udev *udev, int type)
+{
+	struct udev_monitor *um;
+	const char *msg;
+	int lfd, fd, mfd, i, seq, total;
+
+	lfd = devd_listen(type);
+	um = monitor_new(udev);
+	mfd = udev_monitor_get_fd(um);
+	fd = accept(lfd, NULL, NULL);
+	CHECK(fd >= 0);
+
+	/* Nothing is pending yet */
+	seq = 0;
+	CHECK(!wait_fd(mfd, 0));
+	CHECK(receive(um, 1, &seq) == 0);
+
+	/* Stream socket reassembles line written in two pieces */
+	if (type == SOCK_STREAM) {
+		msg = notices[0];
+		CHECK(write(fd, msg, 10) == 10);
+		CHECK(wait_fd(mfd, 5000));
+		CHECK(receive(um, 1, &seq) == 0);
+		devd_send(fd, msg + 10);
+		CHECK(wait_fd(mfd, 5000));
+		CHECK(receive(um, 1, &seq) == 1);
+	}
+
+	/* Twice the ring size is delivered without drops */
+	total = RING_SLOTS * 2;
+	for (i = seq; i < seq + total; i++)
+		devd_send(fd, notices[i % nitems(notices)]);
+	total += seq;
+	while (seq < total) {
+		CHECK(wait_fd(mfd, 5000));
+		receive(um, 3, &seq);
+	}
+	CHECK(receive(um, 1, &seq) == 0);
+
+	/* Monitor reconnects after devd restart */
+	close(fd);
+	CHECK(fcntl(lfd, F_SETFL, O_NONBLOCK) == 0);
+	while ((fd = accept(lfd, NULL, NULL)) < 0) {
+		if (wait_fd(mfd, 100))
+			CHECK(receive(um, 1, &seq) == 0);
+	}
+	devd_send(fd, notices[seq % nitems(notices)]);
+	CHECK(wait_fd(mfd, 5000));
+	while (receive(um, 1, &seq) == 0)
+		CHECK(wait_fd(mfd, 5000));
+
+	udev_monitor_unref(um);
+	close(fd);
+	close(lfd);
+	devd_unlink();
+}
+
+int
+main(void)
+{
+	struct udev *udev;
+
+	alarm(20);
+	udev = udev_new();
+	CHECK(udev != NULL);
+	test_socket(udev, SOCK_SEQPACKET);
+	test_socket(udev, SOCK_STREAM);
+	udev_unref(udev);
+
+	return (0);
+}
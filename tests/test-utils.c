@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Socket standing in for devd one and benchmark clocks */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "test-utils.h"
+
+static char devd_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+/* Creates listening socket and names it in environment for the library */
+int
+devd_listen(int type)
+{
+	struct sockaddr_un sa;
+	int fd;
+
+	snprintf(devd_path, sizeof(devd_path), "/tmp/libudev-devd-test.%d",
+	    (int)getpid());
+	unlink(devd_path);
+	fd = socket(PF_UNIX, type, 0);
+	CHECK(fd >= 0);
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, devd_path);
+	CHECK(bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+	CHECK(listen(fd, 4) == 0);
+	CHECK(setenv("LIBUDEV_DEVD_SOCKET", devd_path, 1) == 0);
+
+	return (fd);
+}
+
+void
+devd_unlink(void)
+{
+
+	unlink(devd_path);
+}
+
+void
+devd_send(int fd, const char *msg)
+{
+
+	CHECK(write(fd, msg, strlen(msg)) == (ssize_t)strlen(msg));
+}
+
+/* Returns monotonic time in seconds */
+double
+bench_now(void)
+{
+	struct timespec ts;
+
+	CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/* Returns read(2) calls made by the process so far or -1 if unknown */
+long
+bench_read_calls(void)
+{
+	FILE *f;
+	char key[32];
+	long value, calls = -1;
+
+	/* Only Linux procfs accounts them */
+	f = fopen("/proc/self/io", "r");
+	if (f == NULL)
+		return (-1);
+	while (fscanf(f, "%31s %ld", key, &value) == 2)
+		if (strcmp(key, "syscr:") == 0)
+			calls = value;
+	fclose(f);
+
+	return (calls);
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Storms threaded udev_monitor with bursts of random length and drains
+ * them in random batches while monitor thread keeps queueing. Checks
+ * that monitor descriptor is readable exactly while devices are queued
+ * and that blocking receive waits for a device.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "libudev.h"
+#include "test-utils.h"
+
+#define	STRESS_ROUNDS	5000
+#define	STRESS_BURST	64	/* longest burst, well below ring size */
+#define	STRESS_BATCH	8	/* largest receive batch */
+
+static bool
+wait_fd(int fd, int msec)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return (poll(&pfd, 1, msec) == 1);
+}
+
+/* Receives up to count devices. Descriptor was found readable */
+static int
+receive(struct udev_monitor *um, int count)
+{
+	struct udev_device *devices[STRESS_BATCH];
+	int n;
+
+	if (count == 1) {
+		devices[0] = udev_monitor_receive_device(um);
+		CHECK(devices[0] != NULL);
+		n = 1;
+	} else {
+		n = udev_monitor_receive_devices(um, devices, count,
+		    UDEV_MONITOR_NONBLOCK);
+		CHECK(n > 0 && n <= count);
+	}
+	for (count = 0; count < n; count++) {
+		CHECK(STREQ(udev_device_get_syspath(devices[count]),
+		    "/dev/input/event1"));
+		udev_device_unref(devices[count]);
+	}
+
+	return (n);
+}
+
+static void *
+send_later(void *args)
+{
+	int fd = *(int *)args;
+
+	usleep(100000);
+	devd_send(fd, NOTICE("CREATE", "input/event1"));
+	return (NULL);
+}
+
+int
+main(void)
+{
+	static char burst[STRESS_BURST * 64];
+	const char *msg = NOTICE("CREATE", "input/event1");
+	struct udev *udev;
+	struct udev_monitor *um;
+	struct udev_device *ud;
+	pthread_t thread;
+	unsigned int seed = 1;
+	size_t len;
+	int lfd, fd, mfd, i, n, received;
+
+	alarm(60);
+	lfd = devd_listen(SOCK_STREAM);
+
+	udev = udev_new();
+	CHECK(udev != NULL);
+	um = udev_monitor_new_from_netlink(udev, "udev");
+	CHECK(um != NULL);
+	CHECK(udev_monitor_filter_add_match_subsystem_devtype(um, "input",
+	    NULL) == 0);
+	CHECK(udev_monitor_enable_receiving(um) == 0);
+	mfd = udev_monitor_get_fd(um);
+	fd = accept(lfd, NULL, NULL);
+	CHECK(fd >= 0);
+
+	len = strlen(msg);
+	for (i = 0; i < STRESS_BURST; i++)
+		memcpy(burst + i * len, msg, len);
+
+	for (i = 0; i < STRESS_ROUNDS; i++) {
+		n = 1 + rand_r(&seed) % STRESS_BURST;
+		CHECK(write(fd, burst, len * n) == (ssize_t)(len * n));
+		for (received = 0; received < n;) {
+			CHECK(wait_fd(mfd, 5000));
+			received += receive(um,
+			    1 + rand_r(&seed) % STRESS_BATCH);
+		}
+		CHECK(received == n);
+		/* Drained ring leaves no stale wakeup behind */
+		CHECK(!wait_fd(mfd, 0));
+	}
+
+	/* Blocking receive waits for device queued later */
+	CHECK(pthread_create(&thread, NULL, send_later, &fd) == 0);
+	ud = udev_monitor_receive_device(um);
+	CHECK(ud != NULL);
+	CHECK(STREQ(udev_device_get_syspath(ud), "/dev/input/event1"));
+	udev_device_unref(ud);
+	CHECK(pthread_join(thread, NULL) == 0);
+	CHECK(!wait_fd(mfd, 0));
+
+	udev_monitor_unref(um);
+	close(fd);
+	close(lfd);
+	devd_unlink();
+	udev_unref(udev);
+	return (0);
+}
@@ -0,0 +1,713 @@
+/*
+ * Copyright (c) 2026 The libudev-devd contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#include "config.h"
+#include "udev-backend.h"
+#include "udev-utils.h"
+#include "utils.h"
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/queue.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYSTEM_BACKEND
+#include <sys/sysctl.h>
+#endif
+#include <sys/tree.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYSTEM_BACKEND
+/*
+ * Descriptors the application has open on character devices, indexed by
+ * device number. Entries are checked with fstat() before use as the
+ * application may close or reuse them at any time. Index is rebuilt on
+ * the first miss after reset, so further misses until the next probe pass
+ * or devd event cost no descriptor table scan.
+ */
+struct system_fd {
+	RB_ENTRY(system_fd) link;
+	dev_t rdev;
+	int fd;
+};
+
+static int system_fd_cmp(struct system_fd *sf1, struct system_fd *sf2);
+
+RB_HEAD(system_fds, system_fd);
+RB_PROTOTYPE_STATIC(system_fds, system_fd, link, system_fd_cmp);
+
+struct system_backend {
+	pthread_mutex_t mtx;
+	struct system_fds fds;
+	bool scanned;		/* fds is rebuilt since last reset */
+};
+
+static int
+system_sysctlbyname(void *priv __unused, const char *name, void *oldp,
+    size_t *oldlenp)
+{
+
+	return (sysctlbyname(name, oldp, oldlenp, NULL, 0));
+}
+
+static int
+system_devname(void *priv __unused, dev_t devnum, char *buf, size_t len)
+{
+
+	return (devname_r(devnum, S_IFCHR, buf, len) == NULL ? -1 : 0);
+}
+
+static int
+system_stat(void *priv __unused, const char *path, struct stat *st)
+{
+
+	return (stat(path, st));
+}
+
+static int
+system_lstat(void *priv __unused, const char *path, struct stat *st)
+{
+
+	return (lstat(path, st));
+}
+
+static int
+system_scandir(void *priv __unused, char *path, size_t len,
+    struct scan_ctx *ctx)
+{
+
+	return (scandir_recursive(path, len, ctx));
+}
+
+static int
+system_scandev(void *priv __unused, struct scan_ctx *ctx)
+{
+
+#ifdef HAVE_DEVINFO_H
+	return (scandev_recursive(ctx));
+#else
+	return (0);
+#endif
+}
+
+static void
+system_flush_fds(struct system_backend *sb)
+{
+	struct system_fd *sf1, *sf2;
+
+	RB_FOREACH_SAFE(sf1, system_fds, &sb->fds, sf2) {
+		RB_REMOVE(system_fds, &sb->fds, sf1);
+		free(sf1);
+	}
+}
+
+/* Lowest descriptor is kept if several are open on the same device */
+static void
+system_index_fd(int fd, dev_t rdev, void *args)
+{
+	struct system_backend *sb = args;
+	struct system_fd *sf;
+
+	sf = malloc(sizeof(struct system_fd));
+	if (sf == NULL)
+		return;
+	sf->rdev = rdev;
+	sf->fd = fd;
+	if (RB_INSERT(system_fds, &sb->fds, sf) != NULL)
+		free(sf);
+}
+
+/* Returns indexed descriptor still open on rdev or -1 */
+static int
+system_find_fd(struct system_backend *sb, dev_t rdev)
+{
+	struct system_fd key, *sf;
+	struct stat st;
+
+	key.rdev = rdev;
+	sf = RB_FIND(system_fds, &sb->fds, &key);
+	if (sf == NULL)
+		return (-1);
+	if (fstat(sf->fd, &st) == 0 && S_ISCHR(st.st_mode) &&
+	    st.st_rdev == rdev)
+		return (sf->fd);
+
+	RB_REMOVE(system_fds, &sb->fds, sf);
+	free(sf);
+	return (-1);
+}
+
+/* Reuses descriptor the application has opened if any */
+static int
+system_open(void *priv, const char *path, bool *opened)
+{
+	struct system_backend *sb = priv;
+	struct stat st;
+	int fd = -1;
+
+	*opened = false;
+	if (stat(path, &st) == 0 && S_ISCHR(st.st_mode)) {
+		pthread_mutex_lock(&sb->mtx);
+		fd = system_find_fd(sb, st.st_rdev);
+		if (fd == -1 && !sb->scanned) {
+			system_flush_fds(sb);
+			scan_fds(system_index_fd, sb);
+			sb->scanned = true;
+			fd = system_find_fd(sb, st.st_rdev);
+		}
+		pthread_mutex_unlock(&sb->mtx);
+	}
+	if (fd == -1) {
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		*opened = true;
+	}
+
+	return (fd);
+}
+
+static void
+system_reset(void *priv)
+{
+	struct system_backend *sb = priv;
+
+	pthread_mutex_lock(&sb->mtx);
+	sb->scanned = false;
+	pthread_mutex_unlock(&sb->mtx);
+}
+
+static void
+system_free(void *priv)
+{
+	struct system_backend *sb = priv;
+
+	system_flush_fds(sb);
+	pthread_mutex_destroy(&sb->mtx);
+	free(sb);
+}
+
+static struct system_backend *
+system_new(void)
+{
+	struct system_backend *sb;
+
+	sb = calloc(1, sizeof(struct system_backend));
+	if (sb == NULL)
+		return (NULL);
+	pthread_mutex_init(&sb->mtx, NULL);
+	RB_INIT(&sb->fds);
+
+	return (sb);
+}
+
+static const struct udev_backend_ops system_ops = {
+	.sysctlbyname = system_sysctlbyname,
+	.devname = system_devname,
+	.stat = system_stat,
+	.lstat = system_lstat,
+	.scandir = system_scandir,
+	.scandev = system_scandev,
+	.open = system_open,
+	.reset = system_reset,
+	.free = system_free,
+};
+#endif /* HAVE_SYSTEM_BACKEND */
+
+#ifdef ENABLE_FIXTURE
+/*
+ * Fixture backend serves system state recorded in a text file, so the
+ * library can be exercised without FreeBSD kernel. Each line is one of:
+ *
+ *   node <path> <devnum>		character device node
+ *   link <path> <target>		symbolic link to node
+ *   device <name>			attached newbus device
+ *   sysctl <name> <string>		string sysctl, rest of line
+ *   sysctl.int <name> <number>		int sysctl
+ *   sysctl.hex <name> <hex bytes>	opaque sysctl, e.g. bitmaps
+ *
+ * Empty lines and lines starting with '#' are skipped.
+ */
+struct fixture_node {
+	RB_ENTRY(fixture_node) link;
+	mode_t mode;
+	dev_t rdev;
+	char *target;		/* of symbolic link */
+	char path[];
+};
+
+struct fixture_sysctl {
+	RB_ENTRY(fixture_sysctl) link;
+	char *name;
+	size_t len;
+	unsigned char value[];
+};
+
+struct fixture_device {
+	STAILQ_ENTRY(fixture_device) next;
+	char name[];
+};
+
+static int fixture_node_cmp(struct fixture_node *fn1,
+    struct fixture_node *fn2);
+static int fixture_sysctl_cmp(struct fixture_sysctl *fs1,
+    struct fixture_sysctl *fs2);
+
+RB_HEAD(fixture_nodes, fixture_node);
+RB_PROTOTYPE_STATIC(fixture_nodes, fixture_node, link, fixture_node_cmp);
+RB_HEAD(fixture_sysctls, fixture_sysctl);
+RB_PROTOTYPE_STATIC(fixture_sysctls, fixture_sysctl, link, fixture_sysctl_cmp);
+
+struct fixture {
+	struct fixture_nodes nodes;
+	struct fixture_sysctls sysctls;
+	STAILQ_HEAD(, fixture_device) devices;
+};
+
+static struct fixture_node *
+fixture_find_node(struct fixture *fx, const char *path)
+{
+	struct fixture_node *fn;
+	int cmp;
+
+	fn = RB_ROOT(&fx->nodes);
+	while (fn != NULL) {
+		cmp = strcmp(path, fn->path);
+		if (cmp == 0)
+			break;
+		fn = cmp < 0 ? RB_LEFT(fn, link) : RB_RIGHT(fn, link);
+	}
+
+	return (fn);
+}
+
+static int
+fixture_sysctlbyname(void *priv, const char *name, void *oldp,
+    size_t *oldlenp)
+{
+	struct fixture *fx = priv;
+	struct fixture_sysctl key, *fs;
+
+	key.name = (char *)name;
+	fs = RB_FIND(fixture_sysctls, &fx->sysctls, &key);
+	if (fs == NULL) {
+		errno = ENOENT;
+		return (-1);
+	}
+
+	if (oldp != NULL) {
+		memcpy(oldp, fs->value, MIN(*oldlenp, fs->len));
+		if (*oldlenp < fs->len) {
+			errno = ENOMEM;
+			return (-1);
+		}
+	}
+	*oldlenp = fs->len;
+	return (0);
+}
+
+static int
+fixture_devname(void *priv, dev_t devnum, char *buf, size_t len)
+{
+	struct fixture *fx = priv;
+	struct fixture_node *fn;
+	size_t root_len = strlen(DEV_PATH_ROOT "/");
+
+	RB_FOREACH(fn, fixture_nodes, &fx->nodes) {
+		if (S_ISCHR(fn->mode) && fn->rdev == devnum &&
+		    strncmp(fn->path, DEV_PATH_ROOT "/", root_len) == 0) {
+			strlcpy(buf, fn->path + root_len, len);
+			return (0);
+		}
+	}
+
+	errno = ENOENT;
+	return (-1);
+}
+
+static int
+fixture_lstat(void *priv, const char *path, struct stat *st)
+{
+	struct fixture_node *fn;
+
+	fn = fixture_find_node(priv, path);
+	if (fn == NULL) {
+		errno = ENOENT;
+		return (-1);
+	}
+
+	memset(st, 0, sizeof(*st));
+	st->st_mode = fn->mode;
+	st->st_rdev = fn->rdev;
+	return (0);
+}
+
+static int
+fixture_stat(void *priv, const char *path, struct stat *st)
+{
+	struct fixture_node *fn;
+	int hops;
+
+	for (hops = 0; hops < 8; hops++) {
+		fn = fixture_find_node(priv, path);
+		if (fn == NULL || !S_ISLNK(fn->mode))
+			return (fixture_lstat(priv, path, st));
+		path = fn->target;
+	}
+
+	errno = ELOOP;
+	return (-1);
+}
+
+static int
+fixture_scandir(void *priv, char *path, size_t len __unused,
+    struct scan_ctx *ctx)
+{
+	struct fixture *fx = priv;
+	struct fixture_node *fn;
+	size_t root_len = strlen(path);
+	int type;
+
+	RB_FOREACH(fn, fixture_nodes, &fx->nodes) {
+		if (strncmp(fn->path, path, root_len) != 0)
+			continue;
+		if (!ctx->recursive && strchr(fn->path + root_len, '/') != NULL)
+			continue;
+		type = S_ISLNK(fn->mode) ? DT_LNK : DT_CHR;
+		if ((ctx->cb)(fn->path, type, ctx->args) < 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+static int
+fixture_scandev(void *priv, struct scan_ctx *ctx)
+{
+	struct fixture *fx = priv;
+	struct fixture_device *fd;
+
+	STAILQ_FOREACH(fd, &fx->devices, next)
+		if ((ctx->cb)(fd->name, DT_CHR, ctx->args) < 0)
+			return (-1);
+
+	return (0);
+}
+
+/* Fixture devices can not be opened, so probing relies on sysctls */
+static int
+fixture_open(void *priv __unused, const char *path __unused, bool *opened)
+{
+
+	*opened = false;
+	errno = ENOENT;
+	return (-1);
+}
+
+static void
+fixture_reset(void *priv __unused)
+{
+
+}
+
+static void
+fixture_free(void *priv)
+{
+	struct fixture *fx = priv;
+	struct fixture_node *fn1, *fn2;
+	struct fixture_sysctl *fs1, *fs2;
+	struct fixture_device *fd;
+
+	RB_FOREACH_SAFE(fn1, fixture_nodes, &fx->nodes, fn2) {
+		RB_REMOVE(fixture_nodes, &fx->nodes, fn1);
+		free(fn1->target);
+		free(fn1);
+	}
+	RB_FOREACH_SAFE(fs1, fixture_sysctls, &fx->sysctls, fs2) {
+		RB_REMOVE(fixture_sysctls, &fx->sysctls, fs1);
+		free(fs1->name);
+		free(fs1);
+	}
+	while ((fd = STAILQ_FIRST(&fx->devices)) != NULL) {
+		STAILQ_REMOVE_HEAD(&fx->devices, next);
+		free(fd);
+	}
+	free(fx);
+}
+
+static const struct udev_backend_ops fixture_ops = {
+	.sysctlbyname = fixture_sysctlbyname,
+	.devname = fixture_devname,
+	.stat = fixture_stat,
+	.lstat = fixture_lstat,
+	.scandir = fixture_scandir,
+	.scandev = fixture_scandev,
+	.open = fixture_open,
+	.reset = fixture_reset,
+	.free = fixture_free,
+};
+
+static int
+fixture_add_node(struct fixture *fx, const char *path, mode_t mode,
+    dev_t rdev, const char *target)
+{
+	struct fixture_node *fn, *old_fn;
+
+	fn = calloc(1, offsetof(struct fixture_node, path) + strlen(path) + 1);
+	if (fn == NULL)
+		return (-1);
+	strcpy(fn->path, path);
+	fn->mode = mode;
+	fn->rdev = rdev;
+	if (target != NULL && (fn->target = strdup(target)) == NULL) {
+		free(fn);
+		return (-1);
+	}
+
+	old_fn = RB_INSERT(fixture_nodes, &fx->nodes, fn);
+	if (old_fn != NULL) {
+		free(fn->target);
+		free(fn);
+		errno = EEXIST;
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+fixture_add_sysctl(struct fixture *fx, const char *name, const void *value,
+    size_t len)
+{
+	struct fixture_sysctl *fs;
+
+	fs = malloc(offsetof(struct fixture_sysctl, value) + len);
+	if (fs == NULL)
+		return (-1);
+	fs->name = strdup(name);
+	if (fs->name == NULL) {
+		free(fs);
+		return (-1);
+	}
+	memcpy(fs->value, value, len);
+	fs->len = len;
+
+	if (RB_INSERT(fixture_sysctls, &fx->sysctls, fs) != NULL) {
+		free(fs->name);
+		free(fs);
+		errno = EEXIST;
+		return (-1);
+	}
+	return (0);
+}
+
+/* Decodes hex bytes in place. Returns number of bytes or -1 */
+static ssize_t
+fixture_unhex(char *str)
+{
+	unsigned char *out = (unsigned char *)str;
+	unsigned int byte;
+	size_t len = 0;
+
+	while (*str != '\0') {
+		if (str[1] == '\0' || sscanf(str, "%2x", &byte) != 1)
+			return (-1);
+		out[len++] = byte;
+		str += 2;
+	}
+
+	return (len);
+}
+
+static int
+fixture_parse_line(struct fixture *fx, char *line)
+{
+	char *kind, *name, *value;
+	struct fixture_device *fd;
+	ssize_t len;
+	int num;
+
+	line[strcspn(line, "\n")] = '\0';
+	kind = strsep(&line, " \t");
+	if (kind[0] == '\0' || kind[0] == '#')
+		return (0);
+	name = strsep(&line, " \t");
+	if (name == NULL || name[0] == '\0')
+		return (-1);
+	value = line != NULL ? line + strspn(line, " \t") : "";
+
+	if (strcmp(kind, "node") == 0)
+		return (fixture_add_node(fx, name, S_IFCHR | 0600,
+		    strtoul(value, NULL, 0), NULL));
+	if (strcmp(kind, "link") == 0)
+		return (fixture_add_node(fx, name, S_IFLNK | 0777, 0, value));
+	if (strcmp(kind, "sysctl") == 0)
+		return (fixture_add_sysctl(fx, name, value, strlen(value) + 1));
+	if (strcmp(kind, "sysctl.int") == 0) {
+		num = strtol(value, NULL, 0);
+		return (fixture_add_sysctl(fx, name, &num, sizeof(num)));
+	}
+	if (strcmp(kind, "sysctl.hex") == 0) {
+		len = fixture_unhex(value);
+		if (len < 0)
+			return (-1);
+		return (fixture_add_sysctl(fx, name, value, len));
+	}
+	if (strcmp(kind, "device") == 0) {
+		fd = malloc(offsetof(struct fixture_device, name) +
+		    strlen(name) + 1);
+		if (fd == NULL)
+			return (-1);
+		strcpy(fd->name, name);
+		STAILQ_INSERT_TAIL(&fx->devices, fd, next);
+		return (0);
+	}
+
+	return (-1);
+}
+
+static struct fixture *
+fixture_load(const char *path)
+{
+	struct fixture *fx;
+	char *line = NULL;
+	size_t linecap = 0;
+	int lineno = 0;
+	FILE *fp;
+
+	fp = fopen(path, "re");
+	if (fp == NULL) {
+		ERR("Can not open fixture %s", path);
+		return (NULL);
+	}
+
+	fx = calloc(1, sizeof(struct fixture));
+	if (fx == NULL) {
+		fclose(fp);
+		return (NULL);
+	}
+	RB_INIT(&fx->nodes);
+	RB_INIT(&fx->sysctls);
+	STAILQ_INIT(&fx->devices);
+
+	while (getline(&line, &linecap, fp) > 0) {
+		lineno++;
+		if (fixture_parse_line(fx, line) != 0) {
+			ERR("Bad fixture line %s:%d", path, lineno);
+			fixture_free(fx);
+			fx = NULL;
+			break;
+		}
+	}
+
+	free(line);
+	fclose(fp);
+	return (fx);
+}
+#endif /* ENABLE_FIXTURE */
+
+/*
+ * Creates backend of udev context. In builds with fixture support fixture
+ * named by environment is served instead of the system unless the process
+ * is setuid. Builds without system backend fail when it is not named.
+ */
+struct udev_backend *
+udev_backend_new(void)
+{
+	struct udev_backend *ub;
+#ifdef ENABLE_FIXTURE
+	const char *fixture;
+#endif
+
+	ub = calloc(1, sizeof(struct udev_backend));
+	if (ub == NULL)
+		return (NULL);
+	ub->evdev_enabled = -1;
+
+#ifdef ENABLE_FIXTURE
+	fixture = getenv(UDEV_BACKEND_FIXTURE_ENV);
+	if (fixture != NULL && getuid() == geteuid() && getgid() == getegid()) {
+		ub->ops = &fixture_ops;
+		ub->priv = fixture_load(fixture);
+	}
+#endif
+#ifdef HAVE_SYSTEM_BACKEND
+	if (ub->ops == NULL) {
+		ub->ops = &system_ops;
+		ub->priv = system_new();
+	}
+#endif
+	if (ub->priv == NULL) {
+		free(ub);
+		return (NULL);
+	}
+
+	return (ub);
+}
+
+void
+udev_backend_free(struct udev_backend *ub)
+{
+
+	ub->ops->free(ub->priv);
+	free(ub);
+}
+
+#ifdef HAVE_SYSTEM_BACKEND
+static int
+system_fd_cmp(struct system_fd *sf1, struct system_fd *sf2)
+{
+
+	return (sf1->rdev < sf2->rdev ? -1 : sf1->rdev > sf2->rdev);
+}
+
+RB_GENERATE_STATIC(system_fds, system_fd, link, system_fd_cmp);
+#endif /* HAVE_SYSTEM_BACKEND */
+
+#ifdef ENABLE_FIXTURE
+static int
+fixture_node_cmp(struct fixture_node *fn1, struct fixture_node *fn2)
+{
+
+	return (strcmp(fn1->path, fn2->path));
+}
+
+RB_GENERATE_STATIC(fixture_nodes, fixture_node, link, fixture_node_cmp);
+
+static int
+fixture_sysctl_cmp(struct fixture_sysctl *fs1, struct fixture_sysctl *fs2)
+{
+
+	return (strcmp(fs1->name, fs2->name));
+}
+
+RB_GENERATE_STATIC(fixture_sysctls, fixture_sysctl, link, fixture_sysctl_cmp);
+#endif /* ENABLE_FIXTURE */
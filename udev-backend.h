@@ -0,0 +1,109 @@
+#ifndef UDEV_BACKEND_H_
+#define UDEV_BACKEND_H_
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "utils.h"
+
+/*
+ * Environment variables naming fixture file to serve instead of the system
+ * and socket to read instead of devd one. Honored in builds with fixture.
+ */
+#define	UDEV_BACKEND_FIXTURE_ENV	"LIBUDEV_DEVD_FIXTURE"
+#define	UDEV_BACKEND_DEVD_ENV		"LIBUDEV_DEVD_SOCKET"
+
+/*
+ * System interfaces used to enumerate and probe devices. Every method
+ * follows semantics of the system call it replaces.
+ */
+struct udev_backend_ops {
+	int (*sysctlbyname)(void *priv, const char *name, void *oldp,
+	    size_t *oldlenp);
+	int (*devname)(void *priv, dev_t devnum, char *buf, size_t len);
+	int (*stat)(void *priv, const char *path, struct stat *st);
+	int (*lstat)(void *priv, const char *path, struct stat *st);
+	int (*scandir)(void *priv, char *path, size_t len,
+	    struct scan_ctx *ctx);
+	int (*scandev)(void *priv, struct scan_ctx *ctx);
+	int (*open)(void *priv, const char *path, bool *opened);
+	void (*reset)(void *priv);
+	void (*free)(void *priv);
+};
+
+struct udev_backend {
+	const struct udev_backend_ops *ops;
+	void *priv;
+	int evdev_enabled;	/* cached kern.features.evdev_support */
+};
+
+struct udev_backend *udev_backend_new(void);
+void udev_backend_free(struct udev_backend *ub);
+
+static inline int
+udev_backend_sysctlbyname(struct udev_backend *ub, const char *name,
+    void *oldp, size_t *oldlenp)
+{
+
+	return (ub->ops->sysctlbyname(ub->priv, name, oldp, oldlenp));
+}
+
+static inline int
+udev_backend_devname(struct udev_backend *ub, dev_t devnum, char *buf,
+    size_t len)
+{
+
+	return (ub->ops->devname(ub->priv, devnum, buf, len));
+}
+
+static inline int
+udev_backend_stat(struct udev_backend *ub, const char *path, struct stat *st)
+{
+
+	return (ub->ops->stat(ub->priv, path, st));
+}
+
+static inline int
+udev_backend_lstat(struct udev_backend *ub, const char *path, struct stat *st)
+{
+
+	return (ub->ops->lstat(ub->priv, path, st));
+}
+
+static inline int
+udev_backend_scandir(struct udev_backend *ub, char *path, size_t len,
+    struct scan_ctx *ctx)
+{
+
+	return (ub->ops->scandir(ub->priv, path, len, ctx));
+}
+
+static inline int
+udev_backend_scandev(struct udev_backend *ub, struct scan_ctx *ctx)
+{
+
+	return (ub->ops->scandev(ub->priv, ctx));
+}
+
+static inline int
+udev_backend_open(struct udev_backend *ub, const char *path, bool *opened)
+{
+
+	return (ub->ops->open(ub->priv, path, opened));
+}
+
+/*
+ * Drops what backend has learned about the system since the last reset.
+ * Called when probe pass starts and when devd reports an event.
+ */
+static inline void
+udev_backend_reset(struct udev_backend *ub)
+{
+
+	ub->ops->reset(ub->priv);
+}
+
+#endif /* UDEV_BACKEND_H_ */
@@ -27,6 +27,7 @@
 #include "config.h"
 #include "libudev.h"
 #include "udev.h"
+#include "udev-backend.h"
 #include "udev-device.h"
 #include "udev-filter.h"
 #include "udev-list.h"
@@ -34,23 +35,33 @@
 #include "utils.h"
 
 #include <sys/types.h>
-#include <sys/sysctl.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_SYSMACROS_H
+#include <sys/sysmacros.h>
+#endif
 
 #include <stdarg.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#define	UD_DEVNUM_UNKNOWN	((dev_t)-1)
+
 struct udev_device {
 	_Atomic(int) refcount;
 	struct {
 		unsigned int action : 2;
 		unsigned int is_parent : 1;
+		unsigned int is_cached : 1;	/* shared, immutable */
 	} flags;
+	_Atomic(int) probe_state;	/* lists and parent are set when done */
+	_Atomic(dev_t) devnum;	/* UD_DEVNUM_UNKNOWN until looked up */
+	int config_index;	/* subsystems[] entry or -1 */
+	struct arena arena;	/* storage of list entries */
 	struct udev_list prop_list;
 	struct udev_list sysattr_list;
 	struct udev_list tag_list;
@@ -60,52 +71,114 @@ struct udev_device {
 	char syspath[];
 };
 
+static void udev_device_freeze(struct udev_device *ud);
+
 LIBUDEV_EXPORT struct udev_device *
 udev_device_new_from_syspath(struct udev *udev, const char *syspath)
 {
+	struct udev_device *ud;
 
 	TRC("(%s)", syspath);
-	return (udev_device_new_common(udev, syspath, UD_ACTION_NONE));
+	ud = _udev_cache_get(udev, syspath);
+	if (ud != NULL)
+		return (ud);
+
+	/* Device may be already probed by enumeration filter */
+	ud = _udev_cache_claim(udev, syspath);
+	if (ud == NULL)
+		ud = udev_device_new_common(udev, syspath, UD_ACTION_NONE);
+	if (ud != NULL) {
+		ud->flags.is_cached = 1;
+		if (_udev_cache_put(udev, ud) != 0)
+			ud->flags.is_cached = 0;
+	}
+	return (ud);
 }
 
-LIBUDEV_EXPORT struct udev_device *
-udev_device_new_from_devnum(struct udev *udev, char type, dev_t devnum)
+/* Resolves device node to syspath and PCI_ID of its parent the slow way */
+static int
+udev_device_resolve_devnum(struct udev_backend *ub, dev_t devnum,
+    char *syspath, size_t len, char *pci_id, size_t idlen)
 {
 	char devpath[DEV_PATH_MAX] = DEV_PATH_ROOT "/";
-	char devbuf[32], buf[32], *devbufptr;
-	const char *syspath;
-	struct udev_device *device, *parent;
+	char buf[32], *devbufptr;
 	size_t dev_len;
 	struct stat st;
-	size_t buflen;
 
 	dev_len = strlen(devpath);
-	devname_r(devnum, S_IFCHR, devpath + dev_len, sizeof(devpath) - dev_len);
+	if (udev_backend_devname(ub, devnum, devpath + dev_len,
+	    sizeof(devpath) - dev_len) != 0)
+		return (-1);
 
 	/* Recheck path as devname_r returns zero-terminated garbage on error */
-	if (stat(devpath, &st) != 0 || st.st_rdev != devnum) {
-		TRC("(%d) -> failed", (int)devnum);
-		return NULL;
-	}
+	if (udev_backend_stat(ub, devpath, &st) != 0 || st.st_rdev != devnum)
+		return (-1);
 
-	TRC("(%d) -> %s", (int)devnum, devpath);
-	syspath = get_syspath_by_devpath(devpath);
-	strncpy(devbuf, devpath + 1, 31);
-	devbufptr = devbuf;
+	strlcpy(syspath, get_syspath_by_devpath(devpath), len);
+	strncpy(pci_id, devpath + 1, idlen - 1);
+	pci_id[idlen - 1] = '\0';
+	devbufptr = pci_id;
 	devbufptr = strchrnul(devbufptr, '/');
 	while (*devbufptr != '\0') {
 		*devbufptr = '.';
 		devbufptr = strchrnul(devbufptr, '/');
 	}
-	snprintf(buf, 32, "%.24s.PCI_ID", devbuf);
-	buflen = 32;
+	snprintf(buf, 32, "%.24s.PCI_ID", pci_id);
+
+	udev_backend_sysctlbyname(ub, buf, pci_id, &idlen);
+	return (0);
+}
+
+LIBUDEV_EXPORT struct udev_device *
+udev_device_new_from_devnum(struct udev *udev, char type, dev_t devnum)
+{
+	char syspath[DEV_PATH_MAX], devbuf[32];
+	struct udev_device *device, *parent;
+	struct udev_backend *ub;
+	struct stat st;
 
-	sysctlbyname(buf, devbuf, &buflen, NULL, 0);
+	ub = _udev_get_backend(udev);
+	/* Known device node needs only to be rechecked */
+	if (_udev_devnum_lookup(udev, devnum, syspath, sizeof(syspath),
+	    devbuf, sizeof(devbuf)) == 0) {
+		if (udev_backend_stat(ub, get_devpath_by_syspath(syspath),
+		    &st) != 0 || st.st_rdev != devnum) {
+			_udev_devnum_remove(udev, devnum);
+			syspath[0] = '\0';
+		}
+	} else
+		syspath[0] = '\0';
+
+	if (syspath[0] == '\0') {
+		if (udev_device_resolve_devnum(ub, devnum, syspath,
+		    sizeof(syspath), devbuf, sizeof(devbuf)) != 0) {
+			TRC("(%d) -> failed", (int)devnum);
+			return NULL;
+		}
+		_udev_devnum_insert(udev, devnum, syspath, devbuf);
+	}
 
+	TRC("(%d) -> %s", (int)devnum, syspath);
 	device = udev_device_new_common(udev, syspath, UD_ACTION_NONE);
-	parent = udev_device_new_common(udev, syspath, UD_ACTION_NONE);
+	if (device == NULL)
+		return (NULL);
+	atomic_init(&device->devnum, devnum);
+
+	/*
+	 * Device is probed first as its handler would replace the parent
+	 * otherwise. PCI_ID is attached to the parent the probe has created,
+	 * device is not shared yet, so its parent may still be changed.
+	 */
+	udev_device_probe(device);
+	parent = device->parent;
+	if (parent == NULL) {
+		parent = udev_device_new_common(udev, syspath, UD_ACTION_NONE);
+		if (parent == NULL)
+			return (device);
+		udev_device_set_parent(device, parent);
+	}
 	udev_list_insert(&parent->prop_list, "PCI_ID", devbuf);
-	udev_device_set_parent(device, parent);
+	udev_device_freeze(parent);
 	return (device);
 }
 
@@ -113,10 +186,14 @@ LIBUDEV_EXPORT struct udev_device *
 udev_device_new_from_subsystem_sysname(struct udev *udev,
    const char *subsystem, const char *sysname)
 {
+	char syspath[DEV_PATH_MAX];
 
 	TRC("(%s, %s)", subsystem, sysname);
-	UNIMPL();
-	return (NULL);
+	if (get_syspath_by_subsystem_sysname(udev, subsystem, sysname,
+	    syspath, sizeof(syspath)) != 0)
+		return (NULL);
+
+	return (udev_device_new_from_syspath(udev, syspath));
 }
 
 LIBUDEV_EXPORT char const *
@@ -140,6 +217,7 @@ LIBUDEV_EXPORT struct udev_list_entry *
 udev_device_get_properties_list_entry(struct udev_device *ud)
 {
 
+	udev_device_probe(ud);
 	TRC("(%p(%s))", ud, ud->syspath);
 	return (udev_list_entry_get_first(udev_device_get_properties_list(ud)));
 }
@@ -155,7 +233,7 @@ LIBUDEV_EXPORT struct udev_list_entry *
 udev_device_get_sysattr_list_entry(struct udev_device *ud)
 {
 
-
+	udev_device_probe(ud);
 	TRC("(%p(%s))", ud, ud->syspath);
 	return (udev_list_entry_get_first(udev_device_get_sysattr_list(ud)));
 }
@@ -171,6 +249,7 @@ LIBUDEV_EXPORT struct udev_list_entry *
 udev_device_get_tags_list_entry(struct udev_device *ud)
 {
 
+	udev_device_probe(ud);
 	TRC("(%p(%s))", ud, ud->syspath);
 	return (udev_list_entry_get_first(udev_device_get_tags_list(ud)));
 }
@@ -186,6 +265,7 @@ LIBUDEV_EXPORT struct udev_list_entry *
 udev_device_get_devlinks_list_entry(struct udev_device *ud)
 {
 
+	udev_device_probe(ud);
 	TRC("(%p(%s))", ud, ud->syspath);
 	return (udev_list_entry_get_first(udev_device_get_devlinks_list(ud)));
 }
@@ -193,55 +273,37 @@ udev_device_get_devlinks_list_entry(struct udev_device *ud)
 LIBUDEV_EXPORT char const *
 udev_device_get_property_value(struct udev_device *ud, char const *property)
 {
-	char const *key, *value;
+	char const *value;
 	struct udev_list_entry *entry;
 
-	udev_list_entry_foreach(entry, udev_list_entry_get_first(&ud->prop_list)) {
-		key = _udev_list_entry_get_name(entry);
-		if (!key)
-			continue;
-		if (strcmp(key, property) == 0) {
-			value = _udev_list_entry_get_value(entry);
-			TRC("(%p(%s), %s) %s", ud, ud->syspath, property, value);
-			return (value);
-		}
-	}
-	TRC("(%p(%s), %s) NULL", ud, ud->syspath, property);
-	return (NULL);
+	udev_device_probe(ud);
+	entry = udev_list_find(&ud->prop_list, property);
+	value = entry != NULL ? _udev_list_entry_get_value(entry) : NULL;
+	TRC("(%p(%s), %s) %s", ud, ud->syspath, property, value);
+	return (value);
 }
 
 LIBUDEV_EXPORT char const *
 udev_device_get_sysattr_value(struct udev_device *ud, const char *sysattr)
 {
-	char const *key, *value;
+	char const *value;
 	struct udev_list_entry *entry;
 
-	udev_list_entry_foreach(entry, udev_list_entry_get_first(&ud->sysattr_list)) {
-		key = _udev_list_entry_get_name(entry);
-		if (!key)
-			continue;
-		if (strcmp(key, sysattr) == 0) {
-			value = _udev_list_entry_get_value(entry);
-			TRC("(%p(%s), %s) %s", ud, ud->syspath, sysattr, value);
-			return (value);
-		}
-	}
-	TRC("(%p(%s), %s) NULL", ud, ud->syspath, sysattr);
-	return (NULL);
+	udev_device_probe(ud);
+	entry = udev_list_find(&ud->sysattr_list, sysattr);
+	value = entry != NULL ? _udev_list_entry_get_value(entry) : NULL;
+	TRC("(%p(%s), %s) %s", ud, ud->syspath, sysattr, value);
+	return (value);
 }
 
 LIBUDEV_EXPORT int
 udev_device_set_sysattr_value(struct udev_device *ud, const char *sysattr, const char *value)
 {
-	struct udev_list_entry *entry;
-
-	udev_list_entry_foreach(entry, udev_list_entry_get_first(&ud->sysattr_list)) {
-		char const *key;
 
-		key = _udev_list_entry_get_name(entry);
-		if (key && strcmp(key, sysattr) == 0)
-			return -1;
-	}
+	udev_device_probe(ud);
+	if (ud->flags.is_cached ||
+	    udev_list_find(&ud->sysattr_list, sysattr) != NULL)
+		return -1;
 
 	return udev_list_insert(&ud->sysattr_list, sysattr, value);
 }
@@ -254,6 +316,46 @@ udev_device_get_udev(struct udev_device *ud)
 	return (ud->udev);
 }
 
+/*
+ * Populates device lists and parent on first use with subsystem create
+ * handler. Concurrent first accesses to the same device wait for one
+ * probe, other devices are probed in parallel. Thread that takes the
+ * probe runs it without locks and wakes waiters only if there are any.
+ */
+void
+udev_device_probe(struct udev_device *ud)
+{
+	int state = UD_PROBE_NONE;
+
+	if (atomic_load_explicit(&ud->probe_state, memory_order_acquire) ==
+	    UD_PROBE_DONE)
+		return;
+
+	if (!atomic_compare_exchange_strong(&ud->probe_state, &state,
+	    UD_PROBE_RUNNING)) {
+		if (state != UD_PROBE_DONE)
+			_udev_probe_wait(ud->udev, &ud->probe_state);
+		return;
+	}
+	if (ud->flags.action != UD_ACTION_REMOVE)
+		invoke_create_handler(ud);
+	udev_device_freeze(ud);
+	if (atomic_exchange(&ud->probe_state, UD_PROBE_DONE) ==
+	    UD_PROBE_WAITED)
+		_udev_probe_wakeup(ud->udev);
+}
+
+/* Packs lists of fully constructed device for faster reading */
+static void
+udev_device_freeze(struct udev_device *ud)
+{
+
+	udev_list_freeze(&ud->prop_list);
+	udev_list_freeze(&ud->sysattr_list);
+	udev_list_freeze(&ud->tag_list);
+	udev_list_freeze(&ud->devlink_list);
+}
+
 struct udev_device *
 udev_device_new_common(struct udev *udev, const char *syspath, int action)
 {
@@ -269,17 +371,26 @@ udev_device_new_common(struct udev *udev, const char *syspath, int action)
 	ud->flags.action = action;
 	ud->parent = NULL;
 	atomic_init(&ud->refcount, 1);
+	atomic_init(&ud->probe_state, UD_PROBE_NONE);
+	atomic_init(&ud->devnum, UD_DEVNUM_UNKNOWN);
 	strcpy(ud->syspath, syspath);
-	udev_list_init(&ud->prop_list);
-	udev_list_init(&ud->sysattr_list);
-	udev_list_init(&ud->tag_list);
-	udev_list_init(&ud->devlink_list);
-	if (action != UD_ACTION_REMOVE)
-		invoke_create_handler(ud);
+	ud->config_index = get_subsystem_config_index(syspath);
+	arena_init(&ud->arena);
+	udev_list_init(&ud->prop_list, &ud->arena);
+	udev_list_init(&ud->sysattr_list, &ud->arena);
+	udev_list_init(&ud->tag_list, &ud->arena);
+	udev_list_init(&ud->devlink_list, &ud->arena);
 
 	return (ud);
 }
 
+int
+udev_device_get_config_index(struct udev_device *ud)
+{
+
+	return (ud->config_index);
+}
+
 LIBUDEV_EXPORT const char *
 udev_device_get_syspath(struct udev_device *ud)
 {
@@ -303,7 +414,7 @@ udev_device_get_subsystem(struct udev_device *ud)
 {
 	const char *subsystem;
 
-	subsystem = get_subsystem_by_syspath(udev_device_get_syspath(ud));
+	subsystem = get_subsystem_by_index(ud->udev, ud->config_index);
 	TRC("(%p(%s)) %s", ud, ud->syspath, subsystem);
 	return (subsystem);
 }
@@ -326,6 +437,7 @@ udev_device_free(struct udev_device *ud)
 	udev_list_free(&ud->sysattr_list);
 	udev_list_free(&ud->tag_list);
 	udev_list_free(&ud->devlink_list);
+	arena_free(&ud->arena);
 	if (ud->parent != NULL)
 		udev_device_free(ud->parent);
 	_udev_unref(ud->udev);
@@ -347,6 +459,7 @@ LIBUDEV_EXPORT struct udev_device *
 udev_device_get_parent(struct udev_device *ud)
 {
 
+	udev_device_probe(ud);
 	TRC("(%p/%s) %p", ud, ud->syspath, ud->parent);
 	return (ud->parent);
 }
@@ -356,6 +469,7 @@ udev_device_get_parent_with_subsystem_devtype(struct udev_device *ud,
     const char *subsystem, const char *devtype)
 {
 
+	udev_device_probe(ud);
 	TRC("(%p/%s, %s, %s)", ud, ud->syspath, subsystem, devtype);
 	UNIMPL();
 	return (ud->parent);
@@ -365,7 +479,13 @@ void
 udev_device_set_parent(struct udev_device *ud, struct udev_device *parent)
 {
 
+	/* Parent is populated by its creator and is never probed */
 	parent->flags.is_parent = 1;
+	udev_device_freeze(parent);
+	atomic_store_explicit(&parent->probe_state, UD_PROBE_DONE,
+	    memory_order_release);
+	if (ud->parent != NULL)
+		udev_device_free(ud->parent);
 	ud->parent = parent;
 }
 
@@ -407,15 +527,27 @@ udev_device_get_devnum(struct udev_device *ud)
 {
 	const char *devpath;
 	struct stat st;
+	dev_t devnum;
 
 	TRC("(%p) %s", ud, ud->syspath);
+	devnum = atomic_load_explicit(&ud->devnum, memory_order_relaxed);
+	if (devnum != UD_DEVNUM_UNKNOWN)
+		return (devnum);
+
+	/* Devices found with devinfo have no node to stat */
 	devpath = get_devpath_by_syspath(ud->syspath);
-	if (devpath == NULL ||
-	    stat(devpath, &st) < 0 ||
-	    !S_ISCHR(st.st_mode))
+	if (devpath == NULL || devpath[0] != '/')
+		devnum = makedev(0, 0);
+	else if (udev_backend_stat(_udev_get_backend(ud->udev), devpath,
+	    &st) == 0 && S_ISCHR(st.st_mode))
+		devnum = st.st_rdev;
+	else
+		/* Node may appear later, so the miss is not cached */
 		return (makedev(0, 0));
 
-	return (st.st_rdev);
+	/* Racing threads store the same value */
+	atomic_store_explicit(&ud->devnum, devnum, memory_order_relaxed);
+	return (devnum);
 }
 
 LIBUDEV_EXPORT const char *
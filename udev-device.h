@@ -12,8 +12,18 @@ enum {
 	UD_ACTION_HOTPLUG,
 };
 
+/* Probe states of udev_device */
+enum {
+	UD_PROBE_NONE,
+	UD_PROBE_RUNNING,
+	UD_PROBE_WAITED,	/* running, other threads wait for it */
+	UD_PROBE_DONE,
+};
+
 struct udev_device *udev_device_new_common(struct udev *udev,
     const char *syspath, int action);
+void udev_device_probe(struct udev_device *ud);
+int udev_device_get_config_index(struct udev_device *ud);
 struct udev_list *udev_device_get_properties_list(struct udev_device *ud);
 struct udev_list *udev_device_get_sysattr_list(struct udev_device *ud);
 struct udev_list *udev_device_get_tags_list(struct udev_device *ud);
@@ -26,6 +26,9 @@
 
 #include "config.h"
 #include "libudev.h"
+#include "udev.h"
+#include "udev-backend.h"
+#include "udev-device.h"
 #include "udev-filter.h"
 #include "udev-list.h"
 #include "udev-utils.h"
@@ -36,6 +39,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,6 +48,7 @@
 struct udev_enumerate {
 	_Atomic(int) refcount;
 	struct udev_filter_head filters;
+	struct arena arena;	/* storage of dev_list entries */
 	struct udev_list dev_list;
 	struct udev *udev;
 };
@@ -62,7 +67,8 @@ udev_enumerate_new(struct udev *udev)
 	udev_ref(udev);
 	atomic_init(&ue->refcount, 1);
 	udev_filter_init(&ue->filters);
-	udev_list_init(&ue->dev_list);
+	arena_init(&ue->arena);
+	udev_list_init(&ue->dev_list, &ue->arena);
 
 	return (ue);
 }
@@ -76,6 +82,17 @@ udev_enumerate_ref(struct udev_enumerate *ue)
 	return (ue);
 }
 
+/* Drops listed devices kept by the scan which nobody has claimed */
+static void
+udev_enumerate_release_devices(struct udev_enumerate *ue)
+{
+	struct udev_list_entry *ule;
+
+	udev_list_entry_foreach(ule, udev_list_entry_get_first(&ue->dev_list))
+		_udev_cache_release(ue->udev, _udev_list_entry_get_name(ule),
+		    ue);
+}
+
 LIBUDEV_EXPORT void
 udev_enumerate_unref(struct udev_enumerate *ue)
 {
@@ -83,7 +100,9 @@ udev_enumerate_unref(struct udev_enumerate *ue)
 	TRC("(%p) refcount=%d", ue, ue->refcount);
 	if (atomic_fetch_sub(&ue->refcount, 1) == 1) {
 		udev_filter_free(&ue->filters);
+		udev_enumerate_release_devices(ue);
 		udev_list_free(&ue->dev_list);
+		arena_free(&ue->arena);
 		udev_unref(ue->udev);
 		free(ue);
 	}
@@ -173,15 +192,24 @@ static int
 enumerate_cb(const char *path, int type, void *arg)
 {
 	struct udev_enumerate *ue = arg;
+	struct udev_device *ud = NULL;
 	const char *syspath;
+	bool matched;
+	int ret = 0;
 
 	if (type == DT_LNK || type == DT_CHR) {
 		syspath = get_syspath_by_devpath(path);
-		if (udev_filter_match(ue->udev, &ue->filters, syspath) &&
+		matched = udev_filter_match(ue->udev, &ue->filters, syspath,
+		    UD_ACTION_NONE, &ud);
+		if (matched &&
 		    udev_list_insert(&ue->dev_list, syspath, NULL) == -1)
-			return (-1);
+			ret = -1;
+		/* Listed device probed by the filter is kept for the caller */
+		if (ud != NULL && (!matched || ret == -1 ||
+		    _udev_cache_hold(ue->udev, ud, ue) != 0))
+			udev_device_unref(ud);
 	}
-	return (0);
+	return (ret);
 }
 
 LIBUDEV_EXPORT int
@@ -189,24 +217,33 @@ udev_enumerate_scan_devices(struct udev_enumerate *ue)
 {
 	struct scan_ctx ctx;
 	char path[DEV_PATH_MAX] = DEV_PATH_ROOT "/";
+	struct udev_backend *ub;
 	int ret;
 
 	TRC("(%p)", ue);
 
+	udev_enumerate_release_devices(ue);
 	udev_list_free(&ue->dev_list);
+	arena_free(&ue->arena);
+	/* Probes of this scan may share what they read */
+	_udev_snapshot_begin(ue->udev);
 	ctx = (struct scan_ctx) {
 		.recursive = true,
 		.cb = enumerate_cb,
 		.args = ue,
 	};
 
-	ret = scandir_recursive(path, sizeof(path), &ctx);
-#ifdef HAVE_DEVINFO_H
+	ub = _udev_get_backend(ue->udev);
+	ret = udev_backend_scandir(ub, path, sizeof(path), &ctx);
 	if (ret == 0)
-		ret = scandev_recursive(&ctx);
-#endif
-	if (ret == -1)
+		ret = udev_backend_scandev(ub, &ctx);
+	_udev_snapshot_end(ue->udev);
+	if (ret == -1) {
+		udev_enumerate_release_devices(ue);
 		udev_list_free(&ue->dev_list);
+		arena_free(&ue->arena);
+	} else
+		udev_list_freeze(&ue->dev_list);
 	return ret;
 }
 
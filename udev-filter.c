@@ -27,8 +27,9 @@
 #include "config.h"
 #include "libudev.h"
 #include "udev-device.h"
-#include "udev-utils.h"
 #include "udev-filter.h"
+#include "udev-list.h"
+#include "udev-utils.h"
 
 #include <sys/types.h>
 #include <sys/queue.h>
@@ -41,23 +42,38 @@
 #include <string.h>
 
 struct udev_filter_entry {
-	int type;
-	int neg;
+	bool expr_glob;		/* expr has wildcards */
+	bool value_glob;	/* value has wildcards */
 	STAILQ_ENTRY(udev_filter_entry) next;
 	char *value;
 	char expr[];
 };
 
+static bool
+is_glob(const char *pattern)
+{
+
+	return (strpbrk(pattern, "*?[\\") != NULL);
+}
+
 void
 udev_filter_init(struct udev_filter_head *ufh)
 {
+	int neg;
 
-	STAILQ_INIT(ufh);
+	ufh->count = 0;
+	for (neg = 0; neg < 2; neg++) {
+		ufh->subsystems[neg] = 0;
+		udev_list_init(&ufh->sysnames[neg], NULL);
+		STAILQ_INIT(&ufh->sysname_globs[neg]);
+		STAILQ_INIT(&ufh->properties[neg]);
+		STAILQ_INIT(&ufh->sysattrs[neg]);
+	}
 }
 
-int
-udev_filter_add(struct udev_filter_head *ufh, int type, int neg,
-    const char *expr, const char *value)
+static int
+udev_filter_add_entry(struct udev_filter_list *ufl, const char *expr,
+    const char *value)
 {
 	struct udev_filter_entry *ufe;
 	size_t exprlen, valuelen;
@@ -70,176 +86,214 @@ udev_filter_add(struct udev_filter_head *ufh, int type, int neg,
 	if (ufe == NULL)
 		return (-1);
 
-	ufe->type = type;
-	ufe->neg = neg;
 	strcpy(ufe->expr, expr);
+	ufe->expr_glob = is_glob(expr);
 	ufe->value = NULL;
 	if (value != NULL) {
 		ufe->value = ufe->expr + exprlen;
 		strcpy(ufe->value, value);
+		ufe->value_glob = is_glob(value);
 	}
-	STAILQ_INSERT_TAIL(ufh, ufe, next);
+	STAILQ_INSERT_TAIL(ufl, ufe, next);
 	return (0);
 }
 
-void
-udev_filter_free(struct udev_filter_head *ufh)
+int
+udev_filter_add(struct udev_filter_head *ufh, int type, int neg,
+    const char *expr, const char *value)
+{
+	int ret;
+
+	neg = neg != 0;
+	switch (type) {
+	case UDEV_FILTER_TYPE_SUBSYSTEM:
+		ufh->subsystems[neg] |= get_subsystem_mask(expr);
+		ret = 0;
+		break;
+	case UDEV_FILTER_TYPE_SYSNAME:
+		if (is_glob(expr))
+			ret = udev_filter_add_entry(&ufh->sysname_globs[neg],
+			    expr, NULL);
+		else
+			ret = udev_list_insert(&ufh->sysnames[neg], expr, NULL);
+		break;
+	case UDEV_FILTER_TYPE_PROPERTY:
+		ret = udev_filter_add_entry(&ufh->properties[neg], expr, value);
+		break;
+	case UDEV_FILTER_TYPE_SYSATTR:
+		ret = udev_filter_add_entry(&ufh->sysattrs[neg], expr, value);
+		break;
+	default:
+		/* Tags and initialization state are not matched */
+		ret = 0;
+		break;
+	}
+
+	if (ret == 0)
+		ufh->count++;
+	return (ret);
+}
+
+static void
+udev_filter_free_list(struct udev_filter_list *ufl)
 {
 	struct udev_filter_entry *ufe1, *ufe2;
 
-	ufe1 = STAILQ_FIRST(ufh);
+	ufe1 = STAILQ_FIRST(ufl);
 	while (ufe1 != NULL) {
 		ufe2 = STAILQ_NEXT(ufe1, next);
 		free(ufe1);
 		ufe1 = ufe2;
 	}
-	STAILQ_INIT(ufh);
+	STAILQ_INIT(ufl);
+}
+
+void
+udev_filter_free(struct udev_filter_head *ufh)
+{
+	int neg;
+
+	for (neg = 0; neg < 2; neg++) {
+		udev_list_free(&ufh->sysnames[neg]);
+		udev_filter_free_list(&ufh->sysname_globs[neg]);
+		udev_filter_free_list(&ufh->properties[neg]);
+		udev_filter_free_list(&ufh->sysattrs[neg]);
+	}
+	udev_filter_init(ufh);
+}
+
+static bool
+match_value(struct udev_filter_entry *ufe, const char *value)
+{
+
+	if (ufe->value == NULL || value == NULL)
+		return (ufe->value == NULL && value == NULL);
+	if (ufe->value_glob)
+		return (fnmatch(ufe->value, value, 0) == 0);
+	return (strcmp(ufe->value, value) == 0);
 }
 
 static bool
 fnmatch_list(struct udev_list *list, struct udev_filter_entry *ufe)
 {
 	struct udev_list_entry *entry;
-	const char *key, *value;
+	const char *key;
+
+	/* Literal names are looked up by key */
+	if (!ufe->expr_glob) {
+		entry = udev_list_find(list, ufe->expr);
+		return (entry != NULL &&
+		    match_value(ufe, _udev_list_entry_get_value(entry)));
+	}
 
 	udev_list_entry_foreach(entry, udev_list_entry_get_first(list)) {
 		key = _udev_list_entry_get_name(entry);
-		if (fnmatch(ufe->expr, key, 0) == 0) {
-			value = _udev_list_entry_get_value(entry);
-			if (ufe->value == NULL && value == NULL)
-				return (true);
-			if (ufe->value != NULL && value != NULL &&
-			    fnmatch(ufe->value, value, 0) == 0)
-				return (true);
-		}
+		if (fnmatch(ufe->expr, key, 0) == 0 &&
+		    match_value(ufe, _udev_list_entry_get_value(entry)))
+			return (true);
 	}
 	return (false);
 }
 
-bool
-udev_filter_match(struct udev *udev, struct udev_filter_head *ufh,
-    const char *syspath)
+static bool
+match_sysname(struct udev_filter_head *ufh, int neg, const char *sysname)
 {
 	struct udev_filter_entry *ufe;
-	struct udev_device *ud = NULL;
-	const char *subsystem, *sysname;
-	int ret;
 
-	subsystem = get_subsystem_by_syspath(syspath);
-	if (strcmp(subsystem, UNKNOWN_SUBSYSTEM) == 0)
-		return (0);
+	if (udev_list_find(&ufh->sysnames[neg], sysname) != NULL)
+		return (true);
 
-	sysname = get_sysname_by_syspath(syspath);
-	/* An empty filter list accepts everything. */
-	ret = STAILQ_EMPTY(ufh);
-
-	STAILQ_FOREACH(ufe, ufh, next) {
-		if (ufe->type == UDEV_FILTER_TYPE_SUBSYSTEM &&
-		    ufe->neg == 0 &&
-		    fnmatch(ufe->expr, subsystem, 0) == 0) {
-			ret = true;
-			break;
-		}
-		if (ufe->type == UDEV_FILTER_TYPE_SYSNAME &&
-		    ufe->neg == 0 &&
-		    fnmatch(ufe->expr, sysname, 0) == 0) {
-			ret = true;
-			break;
-		}
-		if (ufe->type == UDEV_FILTER_TYPE_PROPERTY && ufe->neg == 0) {
-			ud = udev_device_new_common(udev, syspath, UD_ACTION_NONE);
-			if (ud == NULL)
-				break;
-			if (fnmatch_list(
-			    udev_device_get_properties_list(ud), ufe)) {
-				ret = true;
-				break;
-			}
-		}
-		if (ufe->type == UDEV_FILTER_TYPE_SYSATTR && ufe->neg == 0) {
-			if (ud == NULL)
-				ud = udev_device_new_common(udev, syspath,
-				    UD_ACTION_NONE);
-			if (ud == NULL)
-				break;
-			if (fnmatch_list(
-			    udev_device_get_sysattr_list(ud), ufe)) {
-				ret = true;
-				break;
-			}
-		}
-	}
+	STAILQ_FOREACH(ufe, &ufh->sysname_globs[neg], next)
+		if (fnmatch(ufe->expr, sysname, 0) == 0)
+			return (true);
 
-	if (!ret)
-		goto out;
+	return (false);
+}
 
-	STAILQ_FOREACH(ufe, ufh, next) {
-		if (ufe->type == UDEV_FILTER_TYPE_SUBSYSTEM &&
-		    ufe->neg == 1 &&
-		    fnmatch(ufe->expr, subsystem, 0) == 0) {
-			ret = false;
-			break;
-		}
-		if (ufe->type == UDEV_FILTER_TYPE_SYSNAME &&
-		    ufe->neg == 1 &&
-		    fnmatch(ufe->expr, sysname, 0) == 0) {
-			ret = false;
-			break;
-		}
-		if (ufe->type == UDEV_FILTER_TYPE_SYSATTR && ufe->neg == 1) {
-			if (ud == NULL)
-				ud = udev_device_new_common(udev, sysname,
-				    UD_ACTION_NONE);
-			if (ud == NULL)
-				break;
-			if (fnmatch_list(
-			    udev_device_get_sysattr_list(ud), ufe)) {
-				ret = false;
-				break;
-			}
-		}
-	}
+/* Constructs and probes udev_device for property and sysattr matching */
+static struct udev_device *
+udev_filter_get_device(struct udev *udev, const char *syspath, int action,
+    struct udev_device **ud)
+{
 
-out:
-	if (ud != NULL)
-		udev_device_unref(ud);
+	if (*ud == NULL)
+		*ud = udev_device_new_common(udev, syspath, action);
+	if (*ud != NULL)
+		udev_device_probe(*ud);
 
-	return (ret);
+	return (*ud);
+}
+
+static bool
+match_device_list(struct udev *udev, struct udev_filter_list *ufl,
+    const char *syspath, int action, struct udev_device **ud,
+    struct udev_list *(*get_list)(struct udev_device *))
+{
+	struct udev_filter_entry *ufe;
+
+	if (STAILQ_EMPTY(ufl) ||
+	    udev_filter_get_device(udev, syspath, action, ud) == NULL)
+		return (false);
+
+	STAILQ_FOREACH(ufe, ufl, next)
+		if (fnmatch_list(get_list(*ud), ufe))
+			return (true);
+
+	return (false);
 }
 
 /*
- * Returns true if the given @p subsystem is accepted by the
- * filters applied to the enumerator @p ue.
+ * Device passes if the filter list is empty or any positive filter accepts
+ * it, and no negative filter rejects it. Negative property filters are
+ * applied as well, which the earlier matcher skipped. No public call adds
+ * them yet.
+ *
+ * Device constructed for property or sysattr matching is handed back
+ * through udp if it is not NULL so the caller does not probe it again.
+ * Already constructed device may be passed in *udp as well.
  */
 bool
-udev_filter_match_subsystem(struct udev_filter_head *ufh, const char *subsystem)
+udev_filter_match(struct udev *udev, struct udev_filter_head *ufh,
+    const char *syspath, int action, struct udev_device **udp)
 {
-	if (!subsystem)
-		return false;
+	struct udev_device *ud;
+	const char *sysname;
+	uint32_t subsystem;
+	int idx;
+	bool ret;
 
-	if (STAILQ_EMPTY(ufh))
-		return true;
+	ud = udp != NULL ? *udp : NULL;
+	idx = get_subsystem_index_by_syspath(udev, syspath);
+	if (idx < 0) {
+		ret = false;
+		goto out;
+	}
 
-	struct udev_filter_entry *ufe;
+	subsystem = 1u << idx;
+	sysname = get_sysname_by_syspath(syspath);
+	/* An empty filter list accepts everything. */
+	ret = ufh->count == 0 ||
+	    (ufh->subsystems[0] & subsystem) != 0 ||
+	    match_sysname(ufh, 0, sysname) ||
+	    match_device_list(udev, &ufh->properties[0], syspath, action, &ud,
+	        udev_device_get_properties_list) ||
+	    match_device_list(udev, &ufh->sysattrs[0], syspath, action, &ud,
+	        udev_device_get_sysattr_list);
 
-	/* Scan for negative matches */
-	STAILQ_FOREACH(ufe, ufh, next) {
-		if (ufe->type == UDEV_FILTER_TYPE_SUBSYSTEM &&
-			ufe->neg != 0 &&
-			fnmatch(ufe->expr, subsystem, 0) == 0) {
-			return false;
-		}
-	}
+	if (ret && (
+	    (ufh->subsystems[1] & subsystem) != 0 ||
+	    match_sysname(ufh, 1, sysname) ||
+	    match_device_list(udev, &ufh->properties[1], syspath, action, &ud,
+	        udev_device_get_properties_list) ||
+	    match_device_list(udev, &ufh->sysattrs[1], syspath, action, &ud,
+	        udev_device_get_sysattr_list)))
+		ret = false;
 
-	/* Not empty, scan for positive matches */
-	STAILQ_FOREACH(ufe, ufh, next) {
-		if (ufe->type == UDEV_FILTER_TYPE_SUBSYSTEM &&
-			ufe->neg == 0 &&
-			fnmatch(ufe->expr, subsystem, 0) == 0) {
-			return true;
-		}
-	}
+out:
+	if (udp != NULL)
+		*udp = ud;
+	else if (ud != NULL)
+		udev_device_unref(ud);
 
-	/* Not empty, matched nothing */
-	return false;
+	return (ret);
 }
@@ -1,6 +1,9 @@
 #include <sys/types.h>
 #include <sys/queue.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "udev-list.h"
 
 enum {
 	UDEV_FILTER_TYPE_SUBSYSTEM,
@@ -10,13 +13,26 @@ enum {
 	UDEV_FILTER_TYPE_TAG,
 	UDEV_FILTER_TYPE_SYSATTR,
 };
-STAILQ_HEAD(udev_filter_head, udev_filter_entry);
+STAILQ_HEAD(udev_filter_list, udev_filter_entry);
+
+/*
+ * Filters are compiled as they are added. Subsystem patterns become a
+ * bitmap of accepted subsystems[] entries, literal sysnames are kept in
+ * lookup lists and only wildcard patterns are left for fnmatch().
+ * Arrays are indexed by negation flag.
+ */
+struct udev_filter_head {
+	int count;
+	uint32_t subsystems[2];
+	struct udev_list sysnames[2];
+	struct udev_filter_list sysname_globs[2];
+	struct udev_filter_list properties[2];
+	struct udev_filter_list sysattrs[2];
+};
 
 void udev_filter_init(struct udev_filter_head *ufh);
-bool udev_filter_match_subsystem(struct udev_filter_head *ufh,
-    const char *subsystem);
 bool udev_filter_match(struct udev *udev, struct udev_filter_head *ufh,
-    const char *syspath);
+    const char *syspath, int action, struct udev_device **udp);
 int udev_filter_add(struct udev_filter_head *ufh, int type, int neg,
     const char *expr, const char *value);
 void udev_filter_free(struct udev_filter_head *ufh);
@@ -38,85 +38,184 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* udev_list_entry flags */
+#define	ULE_FROZEN	0x01	/* array element */
+#define	ULE_LAST	0x02	/* last array element */
+
 struct udev_list_entry {
 	RB_ENTRY(udev_list_entry) link;
-	char *value;
-	char name[];
+	const char *name;
+	const char *value;
+	int flags;
+	char buf[];	/* name and value */
 };
 
-void udev_list_entry_free(struct udev_list_entry *ule);
+static void udev_list_entry_free(struct udev_list *ul,
+    struct udev_list_entry *ule);
+static void udev_list_thaw(struct udev_list *ul);
 
-RB_PROTOTYPE(udev_list, udev_list_entry, link, udev_list_entry_cmp);
+RB_PROTOTYPE(udev_list_tree, udev_list_entry, link, udev_list_entry_cmp);
 
 void
-udev_list_init(struct udev_list *ul)
+udev_list_init(struct udev_list *ul, struct arena *arena)
 {
 
-	RB_INIT(ul);
+	RB_INIT(&ul->tree);
+	ul->arena = arena;
+	ul->array = NULL;
+	ul->count = 0;
 }
 
 int
 udev_list_insert(struct udev_list *ul, char const *name, char const *value)
 {
 	struct udev_list_entry *ule, *old_ule;
-	size_t namelen, valuelen;
+	size_t namelen, valuelen, size;
 
+	udev_list_thaw(ul);
 	namelen = strlen(name) + 1;
 	valuelen = value == NULL ? 0 : strlen(value) + 1;
-	ule = calloc
-	    (1, offsetof(struct udev_list_entry, name) + namelen + valuelen);
+	size = offsetof(struct udev_list_entry, buf) + namelen + valuelen;
+	if (ul->arena != NULL)
+		ule = arena_alloc(ul->arena, size);
+	else
+		ule = calloc(1, size);
 	if (!ule)
 		return (-1);
 
-	strcpy(ule->name, name);
-	ule->value = NULL;
-	if (value != NULL) {
-		ule->value = ule->name + namelen;
-		strcpy(ule->value, value);
-	}
+	ule->name = strcpy(ule->buf, name);
+	ule->value = value == NULL ? NULL : strcpy(ule->buf + namelen, value);
 
-	old_ule = RB_FIND(udev_list, ul, ule);
+	old_ule = RB_FIND(udev_list_tree, &ul->tree, ule);
 	if (old_ule != NULL) {
-		RB_REMOVE(udev_list, ul, old_ule);
-		udev_list_entry_free(old_ule);
+		RB_REMOVE(udev_list_tree, &ul->tree, old_ule);
+		udev_list_entry_free(ul, old_ule);
+		ul->count--;
 	}
 
-	RB_INSERT(udev_list, ul, ule);
+	RB_INSERT(udev_list_tree, &ul->tree, ule);
+	ul->count++;
 	return (0);
 }
 
+/*
+ * Packs entries of complete list into sorted array carved from the list
+ * arena. Array elements take over names and values from tree nodes,
+ * which are left to the arena. Lists without arena are kept as is.
+ */
+void
+udev_list_freeze(struct udev_list *ul)
+{
+	struct udev_list_entry *ule, *array;
+	size_t i;
+
+	if (ul->array != NULL || ul->arena == NULL || ul->count == 0)
+		return;
+
+	array = arena_alloc(ul->arena, sizeof(*array) * ul->count);
+	if (array == NULL)
+		return;
+
+	i = 0;
+	RB_FOREACH(ule, udev_list_tree, &ul->tree) {
+		array[i].name = ule->name;
+		array[i].value = ule->value;
+		array[i].flags = ULE_FROZEN;
+		i++;
+	}
+	array[i - 1].flags |= ULE_LAST;
+
+	RB_INIT(&ul->tree);
+	ul->array = array;
+}
+
+/* Moves array elements back to the tree before list modification */
+static void
+udev_list_thaw(struct udev_list *ul)
+{
+	size_t i;
+
+	if (ul->array == NULL)
+		return;
+
+	for (i = 0; i < ul->count; i++) {
+		ul->array[i].flags = 0;
+		RB_INSERT(udev_list_tree, &ul->tree, &ul->array[i]);
+	}
+	ul->array = NULL;
+}
+
 void
 udev_list_free(struct udev_list *ul)
 {
 	struct udev_list_entry *ule1, *ule2;
 
-	RB_FOREACH_SAFE (ule1, udev_list, ul, ule2) {
-		RB_REMOVE(udev_list, ul, ule1);
-		udev_list_entry_free(ule1);
+	udev_list_thaw(ul);
+	if (ul->arena == NULL) {
+		RB_FOREACH_SAFE (ule1, udev_list_tree, &ul->tree, ule2) {
+			RB_REMOVE(udev_list_tree, &ul->tree, ule1);
+			udev_list_entry_free(ul, ule1);
+		}
 	}
 
-	RB_INIT(ul);
+	RB_INIT(&ul->tree);
+	ul->count = 0;
 }
 
-void
-udev_list_entry_free(struct udev_list_entry *ule)
+/* Replaced arena entries stay allocated until the arena is released */
+static void
+udev_list_entry_free(struct udev_list *ul, struct udev_list_entry *ule)
 {
 
-	free(ule);
+	if (ul->arena == NULL)
+		free(ule);
+}
+
+static int
+udev_list_entry_search(const void *name, const void *ule)
+{
+
+	return (strcmp(name, ((const struct udev_list_entry *)ule)->name));
+}
+
+/* Looks entry up by name descending the tree or bisecting the array */
+struct udev_list_entry *
+udev_list_find(struct udev_list *ul, const char *name)
+{
+	struct udev_list_entry *ule;
+	int cmp;
+
+	if (ul->array != NULL)
+		return (bsearch(name, ul->array, ul->count,
+		    sizeof(*ul->array), udev_list_entry_search));
+
+	ule = RB_ROOT(&ul->tree);
+	while (ule != NULL) {
+		cmp = strcmp(name, ule->name);
+		if (cmp == 0)
+			break;
+		ule = cmp < 0 ? RB_LEFT(ule, link) : RB_RIGHT(ule, link);
+	}
+
+	return (ule);
 }
 
 struct udev_list_entry *
 udev_list_entry_get_first(struct udev_list *ul)
 {
 
-	return (RB_MIN(udev_list, ul));
+	if (ul->array != NULL)
+		return (ul->array);
+	return (RB_MIN(udev_list_tree, &ul->tree));
 }
 
 LIBUDEV_EXPORT struct udev_list_entry *
 udev_list_entry_get_next(struct udev_list_entry *ule)
 {
 
-	return (RB_NEXT(udev_list,, ule));
+	if (ule->flags & ULE_FROZEN)
+		return (ule->flags & ULE_LAST ? NULL : ule + 1);
+	return (RB_NEXT(udev_list_tree,, ule));
 }
 
 const char *
@@ -160,4 +259,4 @@ udev_list_entry_cmp (struct udev_list_entry *le1, struct udev_list_entry *le2)
 	return (strcmp(le1->name, le2->name));
 }
 
-RB_GENERATE(udev_list, udev_list_entry, link, udev_list_entry_cmp);
+RB_GENERATE(udev_list_tree, udev_list_entry, link, udev_list_entry_cmp);
@@ -2,16 +2,32 @@
 #define UDEV_LIST_H_
 
 #include "libudev.h"
+#include "utils.h"
 
 #include <sys/types.h>
 #include <sys/tree.h>
 
-RB_HEAD(udev_list, udev_list_entry);
+RB_HEAD(udev_list_tree, udev_list_entry);
 
-void udev_list_init(struct udev_list *ul);
+/*
+ * Entries of a list with arena attached are carved from that arena and
+ * released all at once by its owner rather than one by one. Frozen
+ * list keeps its entries in a sorted array instead of the tree until
+ * the next insertion.
+ */
+struct udev_list {
+	struct udev_list_tree tree;
+	struct arena *arena;
+	struct udev_list_entry *array;	/* set if frozen */
+	size_t count;
+};
+
+void udev_list_init(struct udev_list *ul, struct arena *arena);
 int udev_list_insert(struct udev_list *ul, char const *name,
     char const *value);
 void udev_list_free(struct udev_list *ul);
+void udev_list_freeze(struct udev_list *ul);
+struct udev_list_entry *udev_list_find(struct udev_list *ul, const char *name);
 struct udev_list_entry *udev_list_entry_get_first(struct udev_list *ul);
 const char *_udev_list_entry_get_name(struct udev_list_entry *ule);
 const char *_udev_list_entry_get_value(struct udev_list_entry *ule);
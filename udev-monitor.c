@@ -27,27 +27,33 @@
 #include "config.h"
 #include "libudev.h"
 #include "udev.h"
+#include "udev-backend.h"
 #include "udev-device.h"
 #include "udev-utils.h"
 #include "udev-filter.h"
 #include "udev-utils.h"
 #include "utils.h"
 
+#include <sys/param.h>
 #include <sys/types.h>
 #include <sys/event.h>
 #include <sys/queue.h>
+#include <sys/socket.h>
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #define	DEVD_SOCK_PATH		"/var/run/devd.pipe"
+#define	DEVD_SEQPACKET_PATH	"/var/run/devd.seqpacket.pipe"
 #define	DEVD_RECONNECT_INTERVAL	1000	/* reconnect after 1 second */
 
 #define	DEVD_EVENT_ATTACH	'+'
@@ -55,76 +61,260 @@
 #define	DEVD_EVENT_NOTICE	'!'
 #define	DEVD_EVENT_UNKNOWN	'?'
 
-STAILQ_HEAD(udev_monitor_queue_head, udev_monitor_queue_entry);
-struct udev_monitor_queue_entry {
-	struct udev_device *ud;
-	STAILQ_ENTRY(udev_monitor_queue_entry) next;
+/* EVFILT_USER identifiers */
+#define	UDEV_MONITOR_EXIT	1	/* monitor thread is finishing */
+#define	UDEV_MONITOR_PENDING	2	/* threadless ring is not empty */
+
+/* Bounds of udev_device ring capacity. Must be powers of 2 */
+#define	UDEV_MONITOR_QUEUE_SIZE	1024
+#define	UDEV_MONITOR_QUEUE_MIN	16
+#define	UDEV_MONITOR_QUEUE_MAX	65536
+/* Receive buffer bytes accounted per ring slot, about one devd message */
+#define	UDEV_MONITOR_SLOT_BYTES	512
+
+/* devd connection along with kqueue watching it */
+struct devd_conn {
+	int kq;
+	int fd;
+	struct socket_buf sb;
+	line_cb_t cb;		/* called for every devd message */
+	void *args;
 };
 
 struct udev_monitor {
 	_Atomic(int) refcount;
 	int fds[2];
-	int kq;
+	bool threadless;	/* devd is read on udev_monitor_receive_device */
+	struct devd_conn conn;	/* private devd connection of threadless mode */
+	LIST_ENTRY(udev_monitor) link;	/* devd_hub monitor list entry */
 	struct udev_filter_head filters;
 	struct udev *udev;
-	struct udev_monitor_queue_head queue;
-	pthread_mutex_t mtx;
+	/* Single producer / single consumer ring of received devices */
+	struct udev_device **queue;
+	size_t queue_size;
+	_Atomic(size_t) queue_head;	/* consumer position */
+	_Atomic(size_t) queue_tail;	/* producer position */
+	pthread_mutex_t notify_mtx;	/* wakeup byte writes and reads */
+	_Atomic(bool) notified;		/* wakeup byte is in the pipe */
+};
+
+/*
+ * Process wide devd connection and reader thread. Each devd message is
+ * parsed once and fanned out to all threaded monitors. Exists as long as
+ * the monitor list is not empty.
+ */
+struct devd_hub {
+	struct devd_conn conn;
 	pthread_t thread;
+	bool orphaned;		/* last monitor is gone, thread frees hub */
+	LIST_HEAD(, udev_monitor) monitors;
+	/* Referenced copy of monitor list, delivery is done without lock */
+	struct udev_monitor **snapshot;
+	size_t snapshot_size;
 };
 
+static struct devd_hub *devd_hub = NULL;
+static pthread_mutex_t devd_hub_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static bool
+udev_monitor_queue_push(struct udev_monitor *um, struct udev_device *ud)
+{
+	size_t head, tail;
+
+	tail = atomic_load_explicit(&um->queue_tail, memory_order_relaxed);
+	head = atomic_load_explicit(&um->queue_head, memory_order_acquire);
+	if (tail - head == um->queue_size)
+		return (false);
+
+	um->queue[tail & (um->queue_size - 1)] = ud;
+	/* Sequentially consistent to order it before udev_monitor_notify() */
+	atomic_store(&um->queue_tail, tail + 1);
+	return (true);
+}
+
+/* Takes up to count devices off the ring with single snapshot of its tail */
+static int
+udev_monitor_queue_pop(struct udev_monitor *um, struct udev_device **devices,
+    int count)
+{
+	size_t head, tail;
+	int i, n;
+
+	head = atomic_load_explicit(&um->queue_head, memory_order_relaxed);
+	tail = atomic_load_explicit(&um->queue_tail, memory_order_acquire);
+	n = tail - head < (size_t)count ? (int)(tail - head) : count;
+
+	for (i = 0; i < n; i++)
+		devices[i] = um->queue[(head + i) & (um->queue_size - 1)];
+	atomic_store_explicit(&um->queue_head, head + n, memory_order_release);
+	return (n);
+}
+
+static bool
+udev_monitor_queue_empty(struct udev_monitor *um)
+{
+
+	return (atomic_load(&um->queue_head) == atomic_load(&um->queue_tail));
+}
+
+static bool
+udev_monitor_queue_full(struct udev_monitor *um)
+{
+
+	return (atomic_load(&um->queue_tail) - atomic_load(&um->queue_head) ==
+	    um->queue_size);
+}
+
+/*
+ * Wakeup byte is in the pipe exactly while the ring holds devices, so
+ * readable descriptor always has a device for the next receive call.
+ * Byte is written and read only under notify_mtx along with the flag.
+ * Producer skips the lock while the flag is set. Sequentially consistent
+ * accesses make either producer see the flag cleared or consumer see the
+ * device pushed.
+ */
+static void
+udev_monitor_notify(struct udev_monitor *um)
+{
+
+	if (atomic_load(&um->notified))
+		return;
+
+	pthread_mutex_lock(&um->notify_mtx);
+	if (!atomic_load(&um->notified) && !udev_monitor_queue_empty(um)) {
+		if (write(um->fds[1], "*", 1) == 1)
+			atomic_store(&um->notified, true);
+		else
+			ERR("udev_monitor wakeup failed");
+	}
+	pthread_mutex_unlock(&um->notify_mtx);
+}
+
+/* Consumes wakeup byte if the ring has been drained */
+static void
+udev_monitor_clear_notify(struct udev_monitor *um)
+{
+	char buf[1];
+
+	pthread_mutex_lock(&um->notify_mtx);
+	if (atomic_load(&um->notified)) {
+		atomic_store(&um->notified, false);
+		if (!udev_monitor_queue_empty(um))
+			atomic_store(&um->notified, true);
+		else if (read(um->fds[0], buf, 1) != 1)
+			ERR("udev_monitor wakeup read failed");
+	}
+	pthread_mutex_unlock(&um->notify_mtx);
+}
+
+static int devd_conn_dispatch(struct devd_conn *dc,
+    const struct timespec *timeout);
+static void devd_conn_read(struct devd_conn *dc);
+
+/*
+ * Threadless flavour of udev_monitor_receive_devices(). Reads and parses
+ * devd messages on caller's thread. Reading stops while the ring is full,
+ * the rest is left in devd socket. EVFILT_USER event is kept triggered
+ * while the ring is not empty so kqueue descriptor stays readable.
+ */
+static int
+udev_monitor_receive_inline(struct udev_monitor *um,
+    struct udev_device **devices, int count, int flags)
+{
+	static const struct timespec nowait = { 0, 0 };
+	struct kevent ke;
+	int n;
+
+	if (devd_conn_dispatch(&um->conn, &nowait) < 0)
+		return (-1);
+
+	while ((n = udev_monitor_queue_pop(um, devices, count)) == 0) {
+		if (flags & UDEV_MONITOR_NONBLOCK)
+			return (0);
+		if (devd_conn_dispatch(&um->conn, NULL) < 0)
+			return (-1);
+	}
+
+	/* Refill the ring from messages held back while it was full */
+	if (um->conn.sb.stalled && um->conn.fd >= 0)
+		devd_conn_read(&um->conn);
+
+	if (!udev_monitor_queue_empty(um)) {
+		EV_SET(&ke, UDEV_MONITOR_PENDING, EVFILT_USER, 0, NOTE_TRIGGER,
+		    0, 0);
+		kevent(um->conn.kq, &ke, 1, NULL, 0, NULL);
+	}
+
+	return (n);
+}
+
+/*
+ * Fills devices array with up to count received devices. Waits for
+ * monitor thread if there are none unless UDEV_MONITOR_NONBLOCK is set,
+ * so blocking call stores at least one device. Returns number of devices
+ * stored or -1 on error.
+ */
+LIBUDEV_EXPORT int
+udev_monitor_receive_devices(struct udev_monitor *um,
+    struct udev_device **devices, int count, int flags)
+{
+	struct pollfd pfd;
+	int n;
+
+	TRC("(%p, %d, %x)", um, count, flags);
+	if (um->queue == NULL || count < 1)
+		return (0);
+
+	if (um->threadless)
+		return (udev_monitor_receive_inline(um, devices, count, flags));
+
+	while ((n = udev_monitor_queue_pop(um, devices, count)) == 0) {
+		if (flags & UDEV_MONITOR_NONBLOCK)
+			return (0);
+		/* Ring is empty. Wait for monitor thread */
+		pfd.fd = um->fds[0];
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, -1) < 0 ||
+		    (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+			return (-1);
+	}
+	udev_monitor_clear_notify(um);
+
+	return (n);
+}
+
 LIBUDEV_EXPORT struct udev_device *
 udev_monitor_receive_device(struct udev_monitor *um)
 {
-	struct udev_monitor_queue_entry *umqe;
 	struct udev_device *ud;
-	char buf[1];
 
 	TRC("(%p)", um);
-	if (read(um->fds[0], buf, 1) < 0)
-		return (NULL);
-
-	if (STAILQ_EMPTY(&um->queue))
+	if (udev_monitor_receive_devices(um, &ud, 1, 0) < 1)
 		return (NULL);
 
-	pthread_mutex_lock(&um->mtx);
-	umqe = STAILQ_FIRST(&um->queue);
-	STAILQ_REMOVE_HEAD(&um->queue, next);
-	pthread_mutex_unlock(&um->mtx);
-	ud = umqe->ud;
-	free(umqe);
-
 	return (ud);
 }
 
+/* Queues device. It is constructed here if filters did not need it */
 static int
 udev_monitor_send_device(struct udev_monitor *um, const char *syspath,
-    int action)
+    int action, struct udev_device *ud)
 {
-	struct udev_monitor_queue_entry *umqe;
 
-	umqe = calloc(1, sizeof(struct udev_monitor_queue_entry));
-	if (umqe == NULL)
+	if (ud == NULL)
+		ud = udev_device_new_common(um->udev, syspath, action);
+	if (ud == NULL)
 		return (-1);
 
-	umqe->ud = udev_device_new_common(um->udev, syspath, action);
-	if (umqe->ud == NULL) {
-		free(umqe);
-		return (-1);
-	}
-
-	pthread_mutex_lock(&um->mtx);
-	STAILQ_INSERT_TAIL(&um->queue, umqe, next);
-	pthread_mutex_unlock(&um->mtx);
-
-	if (write(um->fds[1], "*", 1) != 1) {
-		pthread_mutex_lock(&um->mtx);
-		STAILQ_REMOVE(&um->queue, umqe, udev_monitor_queue_entry, next);
-		pthread_mutex_unlock(&um->mtx);
-		udev_device_unref(umqe->ud);
-		free(umqe);
+	if (!udev_monitor_queue_push(um, ud)) {
+		ERR("udev_monitor queue overflow, %s dropped", syspath);
+		udev_device_unref(ud);
 		return (-1);
 	}
 
+	/* Only transition from empty to non-empty ring costs a wakeup */
+	if (!um->threadless)
+		udev_monitor_notify(um);
 	return (0);
 }
 
@@ -185,14 +375,42 @@ parse_devd_message(char *msg, char *syspath, size_t syspathlen)
 	return (action);
 }
 
-/* Opens devd socket and set read kevent on success or timer kevent on failure */
+/*
+ * Returns devd socket path. Builds with fixture may substitute the socket
+ * with one named by environment, both socket types are tried on it then.
+ */
+static const char *
+devd_path(const char *path)
+{
+#ifdef ENABLE_FIXTURE
+	const char *env;
+
+	env = getenv(UDEV_BACKEND_DEVD_ENV);
+	if (env != NULL && getuid() == geteuid() && getgid() == getegid())
+		return (env);
+#endif
+	return (path);
+}
+
+/*
+ * Opens devd socket and set read kevent on success or timer kevent on failure.
+ * Stream socket is preferred as one read drains a batch of messages, while
+ * seqpacket one costs a read per message. The latter is used as fallback.
+ */
 static int
-devd_connect(int kq)
+devd_connect(int kq, struct socket_buf *sb)
 {
 	int devd_fd;
 	struct kevent ke;
 
-	devd_fd = socket_connect(DEVD_SOCK_PATH);
+	devd_fd = socket_connect(devd_path(DEVD_SOCK_PATH), SOCK_STREAM);
+	if (devd_fd >= 0)
+		socket_buf_init(sb, SOCK_STREAM);
+	else {
+		devd_fd = socket_connect(devd_path(DEVD_SEQPACKET_PATH),
+		    SOCK_SEQPACKET);
+		socket_buf_init(sb, SOCK_SEQPACKET);
+	}
 
 	if (devd_fd >= 0) {
 		EV_SET(&ke, devd_fd, EVFILT_READ, EV_ADD | EV_ENABLE, 0, 0, 0);
@@ -213,60 +431,298 @@ devd_connect(int kq)
 	return (devd_fd);
 }
 
-static void *
-udev_monitor_thread(void *args)
+static void
+udev_monitor_deliver(struct udev_monitor *um, const char *syspath, int action)
+{
+	struct udev_device *ud = NULL;
+
+	if (udev_filter_match(um->udev, &um->filters, syspath, action, &ud))
+		udev_monitor_send_device(um, syspath, action, ud);
+	else if (ud != NULL)
+		udev_device_unref(ud);
+}
+
+/* Leaves message in the socket buffer while threadless ring is full */
+static bool
+udev_monitor_process_line(char *line, void *args)
 {
 	struct udev_monitor *um = args;
-	char ev[1024], syspath[DEV_PATH_MAX];
-	int devd_fd = -1, ret, action;
+	char syspath[DEV_PATH_MAX];
+	int action;
+
+	if (udev_monitor_queue_full(um))
+		return (false);
+
+	action = parse_devd_message(line, syspath, sizeof(syspath));
+	if (action == UD_ACTION_NONE)
+		return (true);
+
+	_udev_cache_invalidate(um->udev, syspath);
+	udev_monitor_deliver(um, syspath, action);
+	return (true);
+}
+
+/* Parses whole batch of messages queued in the socket. Reconnects on EOF */
+static void
+devd_conn_read(struct devd_conn *dc)
+{
+
+	if (socket_readlines(dc->fd, &dc->sb, dc->cb, dc->args) < 0) {
+		close(dc->fd);
+		dc->fd = devd_connect(dc->kq, &dc->sb);
+	}
+}
+
+/* Handles kevent. Returns false if connection owner is finishing */
+static bool
+devd_conn_handle_kevent(struct devd_conn *dc, struct kevent *ke)
+{
+
+	switch (ke->filter) {
+	case EVFILT_USER:
+		if (ke->ident == UDEV_MONITOR_EXIT)
+			return (false);
+		break;
+	case EVFILT_TIMER:
+		/* connection respawn timer expired */
+		break;
+	case EVFILT_READ:
+		devd_conn_read(dc);
+		break;
+	default:
+		/* XXX: assert() should be placed here */
+		break;
+	}
+
+	if (dc->fd < 0)
+		dc->fd = devd_connect(dc->kq, &dc->sb);
+
+	return (true);
+}
+
+/* Processes pending kevents. NULL timeout waits for at least one */
+static int
+devd_conn_dispatch(struct devd_conn *dc, const struct timespec *timeout)
+{
+	struct kevent ke[4];
+	int i, ret;
+
+	ret = kevent(dc->kq, NULL, 0, ke, nitems(ke), timeout);
+	if (ret == -1 && errno == EINTR)
+		return (0);
+	if (ret < 0)
+		return (-1);
+
+	for (i = 0; i < ret; i++)
+		devd_conn_handle_kevent(dc, &ke[i]);
+
+	return (ret);
+}
+
+static void
+devd_conn_init(struct devd_conn *dc, line_cb_t cb, void *args)
+{
+
+	dc->kq = -1;
+	dc->fd = -1;
+	dc->cb = cb;
+	dc->args = args;
+}
+
+static void
+devd_conn_close(struct devd_conn *dc)
+{
+
+	if (dc->fd >= 0)
+		close(dc->fd);
+	if (dc->kq >= 0)
+		close(dc->kq);
+	dc->fd = -1;
+	dc->kq = -1;
+}
+
+/* Takes a reference to every live monitor attached to the hub */
+static size_t
+devd_hub_snapshot(struct devd_hub *dh)
+{
+	struct udev_monitor *um, **snapshot;
+	size_t n, size;
+	int refs;
+
+	pthread_mutex_lock(&devd_hub_mtx);
+	n = 0;
+	LIST_FOREACH(um, &dh->monitors, link) {
+		if (n == dh->snapshot_size) {
+			size = dh->snapshot_size != 0 ? dh->snapshot_size * 2 : 4;
+			snapshot = reallocarray(dh->snapshot, size,
+			    sizeof(*snapshot));
+			if (snapshot == NULL) {
+				ERR("devd_hub snapshot allocation failed");
+				break;
+			}
+			dh->snapshot = snapshot;
+			dh->snapshot_size = size;
+		}
+		/* Skip monitors whose last reference is being dropped */
+		refs = atomic_load(&um->refcount);
+		while (refs > 0 &&
+		    !atomic_compare_exchange_weak(&um->refcount, &refs, refs + 1))
+			;
+		if (refs > 0)
+			dh->snapshot[n++] = um;
+	}
+	pthread_mutex_unlock(&devd_hub_mtx);
+
+	return (n);
+}
+
+/*
+ * Fans devd message out to monitors. Filters are run and devices are
+ * built outside of devd_hub_mtx, so attach and detach are never held up
+ * by device probing. Caches are invalidated once per udev context.
+ */
+static bool
+devd_hub_process_line(char *line, void *args)
+{
+	struct devd_hub *dh = args;
+	char syspath[DEV_PATH_MAX];
+	size_t i, j, n;
+	int action;
+
+	action = parse_devd_message(line, syspath, sizeof(syspath));
+	if (action == UD_ACTION_NONE)
+		return (true);
+
+	n = devd_hub_snapshot(dh);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < i; j++)
+			if (dh->snapshot[j]->udev == dh->snapshot[i]->udev)
+				break;
+		if (j == i)
+			_udev_cache_invalidate(dh->snapshot[i]->udev, syspath);
+	}
+	for (i = 0; i < n; i++)
+		udev_monitor_deliver(dh->snapshot[i], syspath, action);
+	/* Monitor might be released here. Hub is orphaned then */
+	for (i = 0; i < n; i++)
+		udev_monitor_unref(dh->snapshot[i]);
+
+	return (true);
+}
+
+static void
+devd_hub_free(struct devd_hub *dh)
+{
+
+	devd_conn_close(&dh->conn);
+	free(dh->snapshot);
+	free(dh);
+}
+
+static void *
+devd_hub_thread(void *args)
+{
+	struct devd_hub *dh = args;
+	int ret;
 	struct kevent ke;
 	sigset_t set;
 
 	sigfillset(&set);
 	pthread_sigmask(SIG_BLOCK, &set, NULL);
 
-	for (;;) {
-		if (devd_fd < 0)
-			devd_fd = devd_connect(um->kq);
+	dh->conn.fd = devd_connect(dh->conn.kq, &dh->conn.sb);
 
-		ret = kevent(um->kq, NULL, 0, &ke, 1, NULL);
+	for (;;) {
+		ret = kevent(dh->conn.kq, NULL, 0, &ke, 1, NULL);
 		if (ret == -1 && errno == EINTR)
 			continue;
 		if (ret < 1)
 			break;
 
-		/* edev_monitor is finishing */
-		if (ke.filter == EVFILT_USER)
+		if (!devd_conn_handle_kevent(&dh->conn, &ke) || dh->orphaned)
 			break;
+	}
 
-		/* connection respawn timer expired */
-		if (ke.filter == EVFILT_TIMER) {
-			continue;
-		}
+	if (dh->orphaned)
+		devd_hub_free(dh);
+	return (NULL);
+}
 
-		/* XXX: assert() should be placed here */
-		if (ke.filter != EVFILT_READ)
-			continue;
+/* Starts devd_hub on first call and adds monitor to its fan-out list */
+static int
+devd_hub_attach(struct udev_monitor *um)
+{
+	struct devd_hub *dh = NULL;
+	struct kevent ev;
 
-		if (ke.flags & EV_EOF ||
-		    socket_readline(devd_fd, ev, sizeof(ev)) < 0) {
-			close(devd_fd);
-			devd_fd = -1;
-			continue;
+	pthread_mutex_lock(&devd_hub_mtx);
+	if (devd_hub == NULL) {
+		dh = calloc(1, sizeof(struct devd_hub));
+		if (dh == NULL)
+			goto error;
+
+		devd_conn_init(&dh->conn, devd_hub_process_line, dh);
+		LIST_INIT(&dh->monitors);
+		dh->conn.kq = kqueue();
+		if (dh->conn.kq < 0)
+			goto error;
+
+		EV_SET(&ev, UDEV_MONITOR_EXIT, EVFILT_USER,
+		    EV_ADD | EV_ENABLE | EV_CLEAR, 0, 0, 0);
+		if (kevent(dh->conn.kq, &ev, 1, NULL, 0, NULL) < 0)
+			goto error;
+
+		if (pthread_create(&dh->thread, NULL, devd_hub_thread, dh)
+		    != 0) {
+			ERR("thread_create failed");
+			goto error;
 		}
+		devd_hub = dh;
+	}
+	LIST_INSERT_HEAD(&devd_hub->monitors, um, link);
+	pthread_mutex_unlock(&devd_hub_mtx);
 
-		action = parse_devd_message(ev, syspath, sizeof(syspath));
+	return (0);
+error:
+	pthread_mutex_unlock(&devd_hub_mtx);
+	if (dh != NULL)
+		devd_hub_free(dh);
+	return (-1);
+}
 
-		if (action != UD_ACTION_NONE) {
-			if (udev_filter_match(um->udev, &um->filters, syspath))
-				udev_monitor_send_device(um, syspath, action);
-		}
-	}
+/*
+ * Removes monitor from devd_hub and stops it after the last one is gone.
+ * When the last reference is dropped by the hub thread itself, it can not
+ * be joined, so the thread is detached and frees the hub on its way out.
+ */
+static void
+devd_hub_detach(struct udev_monitor *um)
+{
+	struct devd_hub *dh;
+	struct kevent ev;
 
-	if (devd_fd >= 0)
-		close(devd_fd);
+	pthread_mutex_lock(&devd_hub_mtx);
+	LIST_REMOVE(um, link);
+	dh = devd_hub;
+	if (!LIST_EMPTY(&dh->monitors))
+		dh = NULL;
+	else
+		devd_hub = NULL;
+	pthread_mutex_unlock(&devd_hub_mtx);
+
+	if (dh == NULL)
+		return;
+
+	if (pthread_equal(pthread_self(), dh->thread)) {
+		dh->orphaned = true;
+		pthread_detach(dh->thread);
+		return;
+	}
 
-	return (NULL);
+	EV_SET(&ev, UDEV_MONITOR_EXIT, EVFILT_USER, 0, NOTE_TRIGGER, 0, 0);
+	kevent(dh->conn.kq, &ev, 1, NULL, 0, NULL);
+	pthread_join(dh->thread, NULL);
+	devd_hub_free(dh);
 }
 
 LIBUDEV_EXPORT struct udev_monitor *
@@ -287,11 +743,16 @@ udev_monitor_new_from_netlink(struct udev *udev, const char *name)
 
 	um->udev = udev;
 	_udev_ref(udev);
-	um->kq = -1;
+	um->threadless = false;
+	devd_conn_init(&um->conn, udev_monitor_process_line, um);
 	atomic_init(&um->refcount, 1);
 	udev_filter_init(&um->filters);
-	STAILQ_INIT(&um->queue);
-	pthread_mutex_init(&um->mtx, NULL);
+	um->queue = NULL;
+	um->queue_size = UDEV_MONITOR_QUEUE_SIZE;
+	atomic_init(&um->queue_head, 0);
+	atomic_init(&um->queue_tail, 0);
+	pthread_mutex_init(&um->notify_mtx, NULL);
+	atomic_init(&um->notified, false);
 
 	return (um);
 }
@@ -306,6 +767,46 @@ udev_monitor_filter_add_match_subsystem_devtype(struct udev_monitor *um,
 	    subsystem, NULL));
 }
 
+/*
+ * Sets capacity of the received device queue. The size is given in bytes
+ * like socket receive buffer size, converted to ring slots and rounded up
+ * to the nearest power of 2.
+ */
+LIBUDEV_EXPORT int
+udev_monitor_set_receive_buffer_size(struct udev_monitor *um, int size)
+{
+	size_t queue_size, slots;
+
+	TRC("(%p, %d)", um, size);
+	if (um->queue != NULL || size < 0)
+		return (-1);
+
+	slots = howmany((size_t)size, UDEV_MONITOR_SLOT_BYTES);
+	queue_size = UDEV_MONITOR_QUEUE_MIN;
+	while (queue_size < slots && queue_size < UDEV_MONITOR_QUEUE_MAX)
+		queue_size <<= 1;
+	um->queue_size = queue_size;
+
+	return (0);
+}
+
+/*
+ * Switches udev_monitor to threadless mode. No helper thread is spawned,
+ * udev_monitor_get_fd() returns kqueue descriptor watching devd socket and
+ * udev_monitor_receive_device() parses devd messages on caller's thread.
+ */
+LIBUDEV_EXPORT int
+udev_monitor_set_threadless(struct udev_monitor *um, int threadless)
+{
+
+	TRC("(%p, %d)", um, threadless);
+	if (um->queue != NULL)
+		return (-1);
+
+	um->threadless = threadless != 0;
+	return (0);
+}
+
 LIBUDEV_EXPORT int
 udev_monitor_enable_receiving(struct udev_monitor *um)
 {
@@ -313,25 +814,34 @@ udev_monitor_enable_receiving(struct udev_monitor *um)
 	TRC("(%p)", um);
 	struct kevent ev;
 
-	um->kq = kqueue();
-	if (um->kq < 0)
-		goto error;
+	if (um->queue != NULL)
+		return (0);
+
+	um->queue = calloc(um->queue_size, sizeof(struct udev_device *));
+	if (um->queue == NULL)
+		return (-1);
+
+	if (!um->threadless) {
+		if (devd_hub_attach(um) < 0)
+			goto error;
+		return (0);
+	}
 
-	EV_SET(&ev, 1, EVFILT_USER, EV_ADD | EV_ENABLE | EV_CLEAR, 0, 0, 0);
-	if (kevent(um->kq, &ev, 1, NULL, 0, NULL) < 0)
+	um->conn.kq = kqueue();
+	if (um->conn.kq < 0)
 		goto error;
 
-	if (pthread_create(&um->thread, NULL, udev_monitor_thread, um) != 0) {
-		ERR("thread_create failed");
+	EV_SET(&ev, UDEV_MONITOR_PENDING, EVFILT_USER,
+	    EV_ADD | EV_ENABLE | EV_CLEAR, 0, 0, 0);
+	if (kevent(um->conn.kq, &ev, 1, NULL, 0, NULL) < 0)
 		goto error;
-	}
+	um->conn.fd = devd_connect(um->conn.kq, &um->conn.sb);
 
 	return (0);
 error:
-	if (um->kq >= 0) {
-		close (um->kq);
-		um->kq = -1;
-	}
+	devd_conn_close(&um->conn);
+	free(um->queue);
+	um->queue = NULL;
 	return (-1);
 }
 
@@ -340,7 +850,7 @@ udev_monitor_get_fd(struct udev_monitor *um)
 {
 
 	/* TRC("(%p)", um); */
-	return (um->fds[0]);
+	return (um->threadless && um->conn.kq >= 0 ? um->conn.kq : um->fds[0]);
 }
 
 LIBUDEV_EXPORT struct udev_monitor *
@@ -353,35 +863,34 @@ udev_monitor_ref(struct udev_monitor *um)
 }
 
 static void
-udev_monitor_queue_drop(struct udev_monitor_queue_head *umqh)
+udev_monitor_queue_drop(struct udev_monitor *um)
 {
-	struct udev_monitor_queue_entry *umqe;
+	struct udev_device *ud;
 
-	while (!STAILQ_EMPTY(umqh)) {
-		umqe = STAILQ_FIRST(umqh);
-		STAILQ_REMOVE_HEAD(umqh, next);
-		udev_device_unref(umqe->ud);
-		free(umqe);
-	}
+	if (um->queue == NULL)
+		return;
+
+	while (udev_monitor_queue_pop(um, &ud, 1) == 1)
+		udev_device_unref(ud);
+	free(um->queue);
+	um->queue = NULL;
 }
 
 LIBUDEV_EXPORT void
 udev_monitor_unref(struct udev_monitor *um)
 {
-	struct kevent ev;
 
 	TRC("(%p) refcount=%d", um, um->refcount);
 	if (atomic_fetch_sub(&um->refcount, 1) == 1) {
-		EV_SET(&ev, 1, EVFILT_USER, 0, NOTE_TRIGGER, 0, 0);
-		kevent(um->kq, &ev, 1, NULL, 0, NULL);
-		pthread_join(um->thread, NULL);
-		close(um->kq);
+		if (um->queue != NULL && !um->threadless)
+			devd_hub_detach(um);
+		devd_conn_close(&um->conn);
 
 		close(um->fds[0]);
 		close(um->fds[1]);
+		pthread_mutex_destroy(&um->notify_mtx);
 		udev_filter_free(&um->filters);
-		udev_monitor_queue_drop(&um->queue);
-		pthread_mutex_destroy(&um->mtx);
+		udev_monitor_queue_drop(um);
 		_udev_unref(um->udev);
 		free(um);
 	}
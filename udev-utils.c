@@ -26,6 +26,8 @@
 
 #include "config.h"
 #include "libudev.h"
+#include "udev.h"
+#include "udev-backend.h"
 #include "udev-device.h"
 #include "udev-list.h"
 #include "udev-utils.h"
@@ -33,10 +35,12 @@
 
 #include <sys/param.h>
 #include <sys/types.h>
-#include <sys/sysctl.h>
+#include <sys/stat.h>
 
+#include <assert.h>
 #include <fcntl.h>
 #include <fnmatch.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -44,6 +48,7 @@
 #include <unistd.h>
 
 #ifdef HAVE_LINUX_INPUT_H
+#include <sys/ioctl.h>
 #include <linux/input.h>
 #else
 #define	BUS_PCI		0x01
@@ -139,55 +144,247 @@ struct subsystem_config subsystems[] = {
 		create_drm_handler },
 };
 
-static struct subsystem_config *
-get_subsystem_config_by_syspath(const char *path)
+/*
+ * subsystems[] patterns compiled for lookup by syspath stem, i.e. syspath
+ * cut before the first digit of its last component. "stem[0-9]*" pattern
+ * requires unit digits after the stem, plain path requires none. No other
+ * pattern forms are supported.
+ */
+struct subsystem_stem {
+	const char *stem;
+	size_t len;
+	bool has_unit;
+	int index;
+};
+
+static struct subsystem_stem subsystem_stems[nitems(subsystems)];
+static size_t subsystem_nstems;
+static pthread_once_t subsystem_stems_once = PTHREAD_ONCE_INIT;
+
+#define	UNIT_GLOB	"[0-9]*"
+
+static int
+subsystem_stem_cmp(const char *stem, size_t len, bool has_unit,
+    const struct subsystem_stem *ss)
+{
+	int cmp;
+
+	cmp = memcmp(stem, ss->stem, MIN(len, ss->len));
+	if (cmp != 0)
+		return (cmp);
+	if (len != ss->len)
+		return (len < ss->len ? -1 : 1);
+	if (has_unit != ss->has_unit)
+		return (has_unit ? 1 : -1);
+	return (0);
+}
+
+static int
+subsystem_stem_sort(const void *a, const void *b)
+{
+	const struct subsystem_stem *ss1 = a, *ss2 = b;
+	int cmp;
+
+	cmp = subsystem_stem_cmp(ss1->stem, ss1->len, ss1->has_unit, ss2);
+	return (cmp != 0 ? cmp : ss1->index - ss2->index);
+}
+
+/* Returns length of stem of the first len characters of syspath */
+static size_t
+syspath_stem_len(const char *path, size_t len)
 {
 	size_t i;
 
-	for (i = 0; i < nitems(subsystems); i++)
-		if (fnmatch(subsystems[i].syspath, path, 0) == 0)
-			return (&subsystems[i]);
+	for (i = len; i > 0 && path[i - 1] != '/'; i--)
+		;
+	while (i < len && (path[i] < '0' || path[i] > '9'))
+		i++;
+	return (i);
+}
+
+static void
+compile_subsystem_stems(void)
+{
+	struct subsystem_stem *ss;
+	const char *pattern;
+	size_t i, len;
+
+	for (i = 0; i < nitems(subsystems); i++) {
+		pattern = subsystems[i].syspath;
+		len = strlen(pattern);
+		ss = &subsystem_stems[subsystem_nstems];
+		ss->has_unit = len > strlen(UNIT_GLOB) &&
+		    strcmp(pattern + len - strlen(UNIT_GLOB), UNIT_GLOB) == 0;
+		if (ss->has_unit)
+			len -= strlen(UNIT_GLOB);
+		/* Literal prefix must be a whole stem, "[0-9]*" is not part of it */
+		assert(strcspn(pattern, "*?[\\") >= len &&
+		    syspath_stem_len(pattern, len) == len);
+		ss->stem = pattern;
+		ss->len = len;
+		ss->index = i;
+		subsystem_nstems++;
+	}
+
+	qsort(subsystem_stems, subsystem_nstems, sizeof(subsystem_stems[0]),
+	    subsystem_stem_sort);
+}
+
+/* Returns index of the first subsystems[] entry matching syspath or -1 */
+int
+get_subsystem_config_index(const char *path)
+{
+	size_t len, lo, hi, mid;
+	bool has_unit;
+	int idx = -1;
+
+	pthread_once(&subsystem_stems_once, compile_subsystem_stems);
+
+	/* Lower bound of the stem, that is its entry with lowest index */
+	len = syspath_stem_len(path, strlen(path));
+	has_unit = path[len] != '\0';
+	lo = 0;
+	hi = subsystem_nstems;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (subsystem_stem_cmp(path, len, has_unit,
+		    &subsystem_stems[mid]) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < subsystem_nstems &&
+	    subsystem_stem_cmp(path, len, has_unit, &subsystem_stems[lo]) == 0)
+		idx = subsystem_stems[lo].index;
 
-	return (NULL);
+	return (idx);
+}
+
+static struct subsystem_config *
+get_subsystem_config_by_index(int idx)
+{
+
+	return (idx < 0 ? NULL : &subsystems[idx]);
 }
 
 static bool
-kernel_has_evdev_enabled()
+kernel_has_evdev_enabled(struct udev *udev)
 {
-	static int enabled = -1;
+	struct udev_backend *ub;
+	int enabled;
 	size_t len;
 
-	if (enabled != -1)
-		return (enabled);
+	ub = _udev_get_backend(udev);
+	if (ub->evdev_enabled != -1)
+		return (ub->evdev_enabled);
 
-	if (sysctlbyname("kern.features.evdev_support", &enabled, &len, NULL, 0) < 0)
+	len = sizeof(enabled);
+	if (udev_backend_sysctlbyname(ub, "kern.features.evdev_support",
+	    &enabled, &len) < 0)
 		return (0);
 
+	ub->evdev_enabled = enabled;
 	TRC("() EVDEV enabled: %s", enabled ? "true" : "false");
 	return (enabled);
 }
 
+_Static_assert(nitems(subsystems) <= 32,
+    "subsystems[] does not fit in filter bitmap");
+
+/*
+ * Returns index of subsystems[] entry the device belongs to or -1 for
+ * unknown devices and for devices already exposed through EVDEV.
+ */
+int
+get_subsystem_index_by_syspath(struct udev *udev, const char *syspath)
+{
+	struct subsystem_config *sc;
+
+	sc = get_subsystem_config_by_index(get_subsystem_config_index(syspath));
+	if (sc == NULL || (sc->flags & SCFLAG_SKIP_IF_EVDEV &&
+	    kernel_has_evdev_enabled(udev)))
+		return (-1);
+
+	return (sc - subsystems);
+}
+
+/* Returns bitmap of subsystems[] entries with subsystem matching pattern */
+uint32_t
+get_subsystem_mask(const char *pattern)
+{
+	uint32_t mask = 0;
+	size_t i;
+
+	for (i = 0; i < nitems(subsystems); i++)
+		if (fnmatch(pattern, subsystems[i].subsystem, 0) == 0)
+			mask |= 1u << i;
+
+	return (mask);
+}
+
+/* Returns subsystem of device classified with get_subsystem_config_index() */
 const char *
-get_subsystem_by_syspath(const char *syspath)
+get_subsystem_by_index(struct udev *udev, int idx)
 {
 	struct subsystem_config *sc;
 
-	sc = get_subsystem_config_by_syspath(syspath);
+	sc = get_subsystem_config_by_index(idx);
 	if (sc == NULL)
 		return (UNKNOWN_SUBSYSTEM);
-	if (sc->flags & SCFLAG_SKIP_IF_EVDEV && kernel_has_evdev_enabled()) {
-		TRC("(%s) EVDEV enabled -> skipping device", syspath);
+	if (sc->flags & SCFLAG_SKIP_IF_EVDEV && kernel_has_evdev_enabled(udev)) {
+		TRC("(%s) EVDEV enabled -> skipping device", sc->syspath);
 		return (UNKNOWN_SUBSYSTEM);
 	}
 
 	return (sc->subsystem);
 }
 
+/*
+ * Builds syspath of device node with given subsystem and sysname. Only
+ * directories of subsystems[] entries are tried, so no /dev walk is
+ * needed. Returns -1 if there is no such device.
+ */
+int
+get_syspath_by_subsystem_sysname(struct udev *udev, const char *subsystem,
+    const char *sysname, char *syspath, size_t len)
+{
+	const char *slash;
+	struct stat st;
+	size_t i;
+	int idx;
+
+	if (strchr(sysname, '/') != NULL)
+		return (-1);
+
+	for (i = 0; i < nitems(subsystems); i++) {
+		if (strcmp(subsystems[i].subsystem, subsystem) != 0)
+			continue;
+		slash = strrchr(subsystems[i].syspath, '/');
+		if (snprintf(syspath, len, "%.*s/%s",
+		    (int)(slash - subsystems[i].syspath), subsystems[i].syspath,
+		    sysname) >= (int)len)
+			continue;
+		/* Candidate must be claimed by this very entry */
+		idx = get_subsystem_index_by_syspath(udev, syspath);
+		if (idx != (int)i)
+			continue;
+		if (udev_backend_lstat(_udev_get_backend(udev),
+		    get_devpath_by_syspath(syspath), &st) == 0 &&
+		    (S_ISCHR(st.st_mode) || S_ISLNK(st.st_mode)))
+			return (0);
+	}
+
+	return (-1);
+}
+
 const char *
 get_sysname_by_syspath(const char *syspath)
 {
+	const char *sysname;
 
-	return (strbase(syspath));
+	/* newbus device names reported by devd have no directory part */
+	sysname = strbase(syspath);
+	return (sysname != NULL ? sysname : syspath);
 }
 
 const char *
@@ -207,14 +404,13 @@ get_syspath_by_devpath(const char *devpath)
 void
 invoke_create_handler(struct udev_device *ud)
 {
-	const char *path;
 	struct subsystem_config *sc;
 
-	path = udev_device_get_syspath(ud);
-	sc = get_subsystem_config_by_syspath(path);
+	sc = get_subsystem_config_by_index(udev_device_get_config_index(ud));
 	if (sc == NULL || sc->create_handler == NULL)
 		return;
-	if (sc->flags & SCFLAG_SKIP_IF_EVDEV && kernel_has_evdev_enabled()) {
+	if (sc->flags & SCFLAG_SKIP_IF_EVDEV &&
+	    kernel_has_evdev_enabled(udev_device_get_udev(ud))) {
 		TRC("(%p) EVDEV enabled -> skipping device", ud);
 		return;
 	}
@@ -292,84 +488,213 @@ create_xorg_parent(struct udev_device *ud, const char* sysname,
 #define	LONG_BITS	(sizeof(long) * 8)
 #define	NLONGS(x)	(((x) + LONG_BITS - 1) / LONG_BITS)
 
-static inline bool
-bit_is_set(const unsigned long *array, int bit)
-{
-	return !!(array[bit / LONG_BITS] & (1LL << (bit % LONG_BITS)));
-}
+/* Everything evdev handler needs to know about the unit */
+struct evdev_caps {
+	char name[80];
+	char phys[80];
+	struct input_id id;
+	unsigned long key_bits[NLONGS(KEY_CNT)];
+	unsigned long rel_bits[NLONGS(REL_CNT)];
+	unsigned long abs_bits[NLONGS(ABS_CNT)];
+	unsigned long sw_bits[NLONGS(SW_CNT)];
+	unsigned long prp_bits[NLONGS(INPUT_PROP_CNT)];
+};
 
+/* Returns true if any bit in [start, stop) is set. Scans whole words */
 static inline bool
 bit_find(const unsigned long *array, int start, int stop)
 {
-	int i;
-
-	for (i = start; i < stop; i++)
-		if (bit_is_set(array, i))
+	unsigned long mask;
+	size_t i, last;
+
+	if (start >= stop)
+		return false;
+
+	last = (stop - 1) / LONG_BITS;
+	mask = ~0UL << (start % LONG_BITS);
+	for (i = start / LONG_BITS; i <= last; i++) {
+		if (i == last)
+			mask &= ~0UL >> (LONG_BITS - 1 - (stop - 1) % LONG_BITS);
+		if ((array[i] & mask) != 0)
 			return true;
+		mask = ~0UL;
+	}
 
 	return false;
 }
 
+/* Capability predicates evdev device is classified by */
+enum {
+	EF_KEYS		= 1 << 0,
+	EF_BUTTONS	= 1 << 1,
+	EF_LMR		= 1 << 2,
+	EF_REL		= 1 << 3,
+	EF_REL_X	= 1 << 4,
+	EF_REL_Y	= 1 << 5,
+	EF_ABS		= 1 << 6,
+	EF_ABS_X	= 1 << 7,
+	EF_ABS_Y	= 1 << 8,
+	EF_MT		= 1 << 9,
+	EF_PRESSURE	= 1 << 10,	/* ABS_PRESSURE or BTN_TOUCH */
+	EF_SWITCHES	= 1 << 11,
+	EF_JOYSTICK	= 1 << 12,	/* BTN_JOYSTICK */
+	EF_GAMEPAD	= 1 << 13,	/* BTN_SELECT, BTN_START, BTN_TL or BTN_TR */
+	EF_STYLUS	= 1 << 14,	/* BTN_TOOL_PEN, BTN_STYLUS or BTN_STYLUS2 */
+	EF_FINGER	= 1 << 15,
+	EF_POINTER	= 1 << 16,
+	EF_ACCEL	= 1 << 17,
+};
+
+/* Predicate is set if any bit of [start, stop) is set in the bitmap */
+static const struct evdev_feature {
+	size_t bitmap;		/* offset in struct evdev_caps */
+	int start;
+	int stop;
+	int flag;
+} evdev_features[] = {
+#define	EVDEV_FEATURE(bits, start, stop, flag)				\
+	{ offsetof(struct evdev_caps, bits), (start), (stop), (flag) }
+	EVDEV_FEATURE(key_bits, 0, BTN_MISC, EF_KEYS),
+	EVDEV_FEATURE(key_bits, BTN_MISC, BTN_JOYSTICK, EF_BUTTONS),
+	EVDEV_FEATURE(key_bits, BTN_LEFT, BTN_MIDDLE + 1, EF_LMR),
+	EVDEV_FEATURE(key_bits, BTN_JOYSTICK, BTN_JOYSTICK + 1, EF_JOYSTICK),
+	EVDEV_FEATURE(key_bits, BTN_SELECT, BTN_SELECT + 1, EF_GAMEPAD),
+	EVDEV_FEATURE(key_bits, BTN_START, BTN_START + 1, EF_GAMEPAD),
+	EVDEV_FEATURE(key_bits, BTN_TL, BTN_TL + 1, EF_GAMEPAD),
+	EVDEV_FEATURE(key_bits, BTN_TR, BTN_TR + 1, EF_GAMEPAD),
+	EVDEV_FEATURE(key_bits, BTN_TOOL_PEN, BTN_TOOL_PEN + 1, EF_STYLUS),
+	EVDEV_FEATURE(key_bits, BTN_STYLUS, BTN_STYLUS + 1, EF_STYLUS),
+	EVDEV_FEATURE(key_bits, BTN_STYLUS2, BTN_STYLUS2 + 1, EF_STYLUS),
+	EVDEV_FEATURE(key_bits, BTN_TOOL_FINGER, BTN_TOOL_FINGER + 1,
+	    EF_FINGER),
+	EVDEV_FEATURE(key_bits, BTN_TOUCH, BTN_TOUCH + 1, EF_PRESSURE),
+	EVDEV_FEATURE(rel_bits, 0, REL_CNT, EF_REL),
+	EVDEV_FEATURE(rel_bits, REL_X, REL_X + 1, EF_REL_X),
+	EVDEV_FEATURE(rel_bits, REL_Y, REL_Y + 1, EF_REL_Y),
+	EVDEV_FEATURE(abs_bits, 0, ABS_CNT, EF_ABS),
+	EVDEV_FEATURE(abs_bits, ABS_X, ABS_X + 1, EF_ABS_X),
+	EVDEV_FEATURE(abs_bits, ABS_Y, ABS_Y + 1, EF_ABS_Y),
+	EVDEV_FEATURE(abs_bits, ABS_PRESSURE, ABS_PRESSURE + 1, EF_PRESSURE),
+	EVDEV_FEATURE(abs_bits, ABS_MT_SLOT, ABS_CNT, EF_MT),
+	EVDEV_FEATURE(sw_bits, 0, SW_CNT, EF_SWITCHES),
+	EVDEV_FEATURE(prp_bits, INPUT_PROP_POINTER, INPUT_PROP_POINTER + 1,
+	    EF_POINTER),
+	EVDEV_FEATURE(prp_bits, INPUT_PROP_ACCELEROMETER,
+	    INPUT_PROP_ACCELEROMETER + 1, EF_ACCEL),
+#undef	EVDEV_FEATURE
+};
+
+/*
+ * Derived from EvdevProbe() function of xf86-input-evdev driver. The first
+ * rule whose required predicates are all set and forbidden ones are all
+ * clear gives device type.
+ */
+#define	EF_ABS_XY	(EF_ABS | EF_ABS_X | EF_ABS_Y)
+
+static const struct evdev_rule {
+	int require;
+	int forbid;
+	int input_type;
+} evdev_rules[] = {
+	{ EF_ABS | EF_MT | EF_JOYSTICK, EF_BUTTONS, IT_JOYSTICK },
+	{ EF_ABS_XY | EF_STYLUS, 0, IT_TABLET },
+	{ EF_ABS_XY | EF_GAMEPAD, 0, IT_JOYSTICK },
+	{ EF_ABS_XY | EF_PRESSURE | EF_LMR, 0, IT_TOUCHPAD },
+	{ EF_ABS_XY | EF_PRESSURE | EF_FINGER, 0, IT_TOUCHPAD },
+	{ EF_ABS_XY | EF_PRESSURE, 0, IT_TOUCHSCREEN },
+	/* some touchscreens use BTN_LEFT rather than BTN_TOUCH */
+	{ EF_ABS_XY | EF_LMR, EF_REL_X, IT_TOUCHSCREEN },
+	{ EF_ABS_XY | EF_LMR, EF_REL_Y, IT_TOUCHSCREEN },
+	{ EF_ACCEL, 0, IT_ACCELEROMETER },
+	{ EF_KEYS, 0, IT_KEYBOARD },
+	{ EF_POINTER, 0, IT_MOUSE },
+	{ EF_REL, 0, IT_MOUSE },
+	{ EF_ABS, 0, IT_MOUSE },
+	{ EF_BUTTONS, 0, IT_MOUSE },
+	{ EF_SWITCHES, 0, IT_SWITCH },
+};
+
+static int
+evdev_classify(const struct evdev_caps *caps)
+{
+	const struct evdev_feature *ef;
+	const struct evdev_rule *er;
+	int features = 0;
+
+	for (ef = evdev_features; ef < evdev_features + nitems(evdev_features);
+	    ef++)
+		if ((features & ef->flag) == 0 &&
+		    bit_find((const unsigned long *)
+		    ((const char *)caps + ef->bitmap), ef->start, ef->stop))
+			features |= ef->flag;
+
+	for (er = evdev_rules; er < evdev_rules + nitems(evdev_rules); er++)
+		if ((features & er->require) == er->require &&
+		    (features & er->forbid) == 0)
+			return (er->input_type);
+
+	return (IT_NONE);
+}
+
 void
 create_evdev_handler(struct udev_device *ud)
 {
 	struct udev_device *parent;
+	struct udev *udev;
 	const char *sysname, *unit;
-	char name[80], product[80], phys[80], mib[32];
+	char product[80], mib[32];
 	int fd = -1, input_type = IT_NONE;
 	size_t len;
 	bool opened = false;
-	bool has_keys, has_buttons, has_lmr;
-	bool has_rel_axes, has_abs_axes, has_mt, has_switches;
-	unsigned long key_bits[NLONGS(KEY_CNT)];
-	unsigned long rel_bits[NLONGS(REL_CNT)];
-	unsigned long abs_bits[NLONGS(ABS_CNT)];
-	unsigned long sw_bits[NLONGS(SW_CNT)];
-	unsigned long prp_bits[NLONGS(INPUT_PROP_CNT)];
-	struct input_id id;
+	struct evdev_caps caps;
+	struct udev_backend *ub;
 
+	udev = udev_device_get_udev(ud);
+	ub = _udev_get_backend(udev);
 	sysname = udev_device_get_sysname(ud);
 	len = syspathlen_wo_units(sysname);
 	unit = sysname + len;
 
+	/* Short reads leave the rest of bitmaps zeroed */
+	memset(&caps, 0, sizeof(caps));
 	snprintf(mib, sizeof(mib), "kern.evdev.input.%s.name", unit);
-	len = sizeof(name);
-	if (sysctlbyname(mib, name, &len, NULL, 0) < 0)
+	len = sizeof(caps.name);
+	if (udev_backend_sysctlbyname(ub, mib, caps.name, &len) < 0)
 		goto use_ioctl;
 
 	snprintf(mib, sizeof(mib), "kern.evdev.input.%s.phys", unit);
-	len = sizeof(phys);
-	if (sysctlbyname(mib, phys, &len, NULL, 0) < 0)
+	len = sizeof(caps.phys);
+	if (udev_backend_sysctlbyname(ub, mib, caps.phys, &len) < 0)
 		goto use_ioctl;
 
 	snprintf(mib, sizeof(mib), "kern.evdev.input.%s.id", unit);
-	len = sizeof(id);
-	if (sysctlbyname(mib, &id, &len, NULL, 0) < 0)
+	len = sizeof(caps.id);
+	if (udev_backend_sysctlbyname(ub, mib, &caps.id, &len) < 0)
 		goto use_ioctl;
 
 	snprintf(mib, sizeof(mib), "kern.evdev.input.%s.key_bits", unit);
-	len = sizeof(key_bits);
-	if (sysctlbyname(mib, key_bits, &len, NULL, 0) < 0)
+	len = sizeof(caps.key_bits);
+	if (udev_backend_sysctlbyname(ub, mib, caps.key_bits, &len) < 0)
 		goto use_ioctl;
 
 	snprintf(mib, sizeof(mib), "kern.evdev.input.%s.rel_bits", unit);
-	len = sizeof(rel_bits);
-	if (sysctlbyname(mib, rel_bits, &len, NULL, 0) < 0)
+	len = sizeof(caps.rel_bits);
+	if (udev_backend_sysctlbyname(ub, mib, caps.rel_bits, &len) < 0)
 		goto use_ioctl;
 
 	snprintf(mib, sizeof(mib), "kern.evdev.input.%s.abs_bits", unit);
-	len = sizeof(abs_bits);
-	if (sysctlbyname(mib, abs_bits, &len, NULL, 0) < 0)
+	len = sizeof(caps.abs_bits);
+	if (udev_backend_sysctlbyname(ub, mib, caps.abs_bits, &len) < 0)
 		goto use_ioctl;
 
 	snprintf(mib, sizeof(mib), "kern.evdev.input.%s.sw_bits", unit);
-	len = sizeof(sw_bits);
-	if (sysctlbyname(mib, sw_bits, &len, NULL, 0) < 0)
+	len = sizeof(caps.sw_bits);
+	if (udev_backend_sysctlbyname(ub, mib, caps.sw_bits, &len) < 0)
 		goto use_ioctl;
 
 	snprintf(mib, sizeof(mib), "kern.evdev.input.%s.props", unit);
-	len = sizeof(prp_bits);
-	if (sysctlbyname(mib, prp_bits, &len, NULL, 0) < 0)
+	len = sizeof(caps.prp_bits);
+	if (udev_backend_sysctlbyname(ub, mib, caps.prp_bits, &len) < 0)
 		goto use_ioctl;
 
 	goto found_values;
@@ -377,101 +702,37 @@ create_evdev_handler(struct udev_device *ud)
 use_ioctl:
 	ERR("sysctl not found, opening device and using ioctl");
 
-	fd = path_to_fd(udev_device_get_devnode(ud));
-	if (fd == -1) {
-		fd = open(udev_device_get_devnode(ud), O_RDONLY | O_CLOEXEC);
-		opened = true;
-	}
+	fd = udev_backend_open(ub, udev_device_get_devnode(ud), &opened);
 	if (fd == -1)
 		return;
 
-	if (ioctl(fd, EVIOCGNAME(sizeof(name)), name) < 0 ||
-	    (ioctl(fd, EVIOCGPHYS(sizeof(phys)), phys) < 0 && errno != ENOENT) ||
-	    ioctl(fd, EVIOCGID, &id) < 0 ||
-	    ioctl(fd, EVIOCGBIT(EV_REL, sizeof(rel_bits)), rel_bits) < 0 ||
-	    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits) < 0 ||
-	    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits) < 0 ||
-	    ioctl(fd, EVIOCGBIT(EV_SW, sizeof(sw_bits)), sw_bits) < 0 ||
-	    ioctl(fd, EVIOCGPROP(sizeof(prp_bits)), prp_bits) < 0) {
+	if (ioctl(fd, EVIOCGNAME(sizeof(caps.name)), caps.name) < 0 ||
+	    (ioctl(fd, EVIOCGPHYS(sizeof(caps.phys)), caps.phys) < 0 && errno != ENOENT) ||
+	    ioctl(fd, EVIOCGID, &caps.id) < 0 ||
+	    ioctl(fd, EVIOCGBIT(EV_REL, sizeof(caps.rel_bits)), caps.rel_bits) < 0 ||
+	    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(caps.abs_bits)), caps.abs_bits) < 0 ||
+	    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(caps.key_bits)), caps.key_bits) < 0 ||
+	    ioctl(fd, EVIOCGBIT(EV_SW, sizeof(caps.sw_bits)), caps.sw_bits) < 0 ||
+	    ioctl(fd, EVIOCGPROP(sizeof(caps.prp_bits)), caps.prp_bits) < 0) {
 		ERR("could not query evdev");
 		goto bail_out;
 	}
 
 found_values:
-	/* Derived from EvdevProbe() function of xf86-input-evdev driver */
-	has_keys = bit_find(key_bits, 0, BTN_MISC);
-	has_buttons = bit_find(key_bits, BTN_MISC, BTN_JOYSTICK);
-	has_lmr = bit_find(key_bits, BTN_LEFT, BTN_MIDDLE + 1);
-	has_rel_axes = bit_find(rel_bits, 0, REL_CNT);
-	has_abs_axes = bit_find(abs_bits, 0, ABS_CNT);
-	has_switches = bit_find(sw_bits, 0, SW_CNT);
-	has_mt = bit_find(abs_bits, ABS_MT_SLOT, ABS_CNT);
-
-	if (has_abs_axes) {
-		if (has_mt && !has_buttons) {
-			if (bit_is_set(key_bits, BTN_JOYSTICK)) {
-				input_type = IT_JOYSTICK;
-				goto detected;
-			} else {
-				has_buttons = true;
-			}
-		}
-
-		if (bit_is_set(abs_bits, ABS_X) &&
-		    bit_is_set(abs_bits, ABS_Y)) {
-			if (bit_is_set(key_bits, BTN_TOOL_PEN) ||
-			    bit_is_set(key_bits, BTN_STYLUS) ||
-			    bit_is_set(key_bits, BTN_STYLUS2)) {
-				input_type = IT_TABLET;
-				goto detected;
-			} else if (bit_is_set(key_bits, BTN_SELECT) ||
-			           bit_is_set(key_bits, BTN_START) ||
-			           bit_is_set(key_bits, BTN_TL) ||
-			           bit_is_set(key_bits, BTN_TR)) {
-				input_type = IT_JOYSTICK;
-				goto detected;
-			} else if (bit_is_set(abs_bits, ABS_PRESSURE) ||
-			           bit_is_set(key_bits, BTN_TOUCH)) {
-				if (has_lmr ||
-				    bit_is_set(key_bits, BTN_TOOL_FINGER)) {
-					input_type = IT_TOUCHPAD;
-				} else {
-					input_type = IT_TOUCHSCREEN;
-				}
-				goto detected;
-			} else if (!(bit_is_set(rel_bits, REL_X) &&
-			             bit_is_set(rel_bits, REL_Y)) &&
-			             has_lmr) {
-				/* some touchscreens use BTN_LEFT rather than BTN_TOUCH */
-				input_type = IT_TOUCHSCREEN;
-				goto detected;
-			}
-		}
-	}
-
-	if (bit_is_set(prp_bits, INPUT_PROP_ACCELEROMETER))
-		input_type = IT_ACCELEROMETER;
-	else if (has_keys)
-		input_type = IT_KEYBOARD;
-	else if (bit_is_set(prp_bits, INPUT_PROP_POINTER) || has_rel_axes || has_abs_axes || has_buttons)
-		input_type = IT_MOUSE;
-	else if (has_switches)
-		input_type = IT_SWITCH;
-
+	input_type = evdev_classify(&caps);
 	if (input_type == IT_NONE)
 		goto bail_out;
 
-detected:
 	set_input_device_type(ud, input_type);
 
-	sysname = phys[0] == 0 ? virtual_sysname : phys;
+	sysname = caps.phys[0] == 0 ? virtual_sysname : caps.phys;
 
-	*(strchrnul(name, ',')) = '\0';	/* strip name */
+	*(strchrnul(caps.name, ',')) = '\0';	/* strip name */
 
 	snprintf(product, sizeof(product), "%x/%x/%x/%x",
-	    id.bustype, id.vendor, id.product, id.version);
+	    caps.id.bustype, caps.id.vendor, caps.id.product, caps.id.version);
 
-	parent = create_xorg_parent(ud, sysname, name, product, NULL);
+	parent = create_xorg_parent(ud, sysname, caps.name, product, NULL);
 	if (parent != NULL)
 		udev_device_set_parent(ud, parent);
 
@@ -494,39 +755,38 @@ syspathlen_wo_units(const char *path) {
 	return len;
 }
 
-void
-set_parent(struct udev_device *ud)
+/* Parsed newbus descriptor of the device parent */
+struct newbus_desc {
+	char name[80];
+	char product[80];
+	char pnp_id[32];	/* empty if there is no _HID */
+	char parent[80];	/* newbus parent */
+};
+
+static int
+get_newbus_desc(struct udev_backend *ub, const char *devname,
+    const char *unit, struct newbus_desc *nd)
 {
-        struct udev_device *parent;
-	char devname[DEV_PATH_MAX], mib[32], pnpinfo[1024];
-	char name[80], product[80], parentname[80], *pnp_id;
-	const char *sysname, *unit, *vendorstr, *prodstr, *devicestr;
+	char mib[32], pnpinfo[1024], *pnp_id;
+	const char *vendorstr, *prodstr, *devicestr;
 	size_t len, vendorlen, prodlen, devicelen, pnplen;
 	uint32_t bus, prod, vendor;
 
-	sysname = udev_device_get_sysname(ud);
-	len = syspathlen_wo_units(sysname);
-	/* Check if device unit number found */
-	if (strlen(sysname) == len)
-		return;
-	snprintf(devname, len + 1, "%s", sysname);
-	unit = sysname + len;
-
 	snprintf(mib, sizeof(mib), "dev.%.17s.%.3s.%%desc", devname, unit);
-	len = sizeof(name);
-	if (sysctlbyname(mib, name, &len, NULL, 0) < 0)
-		return;
-	*(strchrnul(name, ',')) = '\0';	/* strip name */
+	len = sizeof(nd->name);
+	if (udev_backend_sysctlbyname(ub, mib, nd->name, &len) < 0)
+		return (-1);
+	*(strchrnul(nd->name, ',')) = '\0';	/* strip name */
 
 	snprintf(mib, sizeof(mib), "dev.%.14s.%.3s.%%pnpinfo", devname, unit);
 	len = sizeof(pnpinfo);
-	if (sysctlbyname(mib, pnpinfo, &len, NULL, 0) < 0)
-		return;
+	if (udev_backend_sysctlbyname(ub, mib, pnpinfo, &len) < 0)
+		return (-1);
 
 	snprintf(mib, sizeof(mib), "dev.%.15s.%.3s.%%parent", devname, unit);
-	len = sizeof(parentname);
-	if (sysctlbyname(mib, parentname, &len, NULL, 0) < 0)
-		return;
+	len = sizeof(nd->parent);
+	if (udev_backend_sysctlbyname(ub, mib, nd->parent, &len) < 0)
+		return (-1);
 
 	vendorstr = get_kern_prop_value(pnpinfo, "vendor", &vendorlen);
 	prodstr = get_kern_prop_value(pnpinfo, "product", &prodlen);
@@ -536,6 +796,7 @@ set_parent(struct udev_device *ud)
 		pnp_id = NULL;
 	if (pnp_id != NULL)
 		pnp_id[pnplen] = '\0';
+	strlcpy(nd->pnp_id, pnp_id != NULL ? pnp_id : "", sizeof(nd->pnp_id));
 	if (prodstr != NULL && vendorstr != NULL) {
 		/* XXX: should parent be compared to uhub* to detect usb? */
 		vendor = strtol(vendorstr, NULL, 0);
@@ -545,7 +806,7 @@ set_parent(struct udev_device *ud)
 		vendor = strtol(vendorstr, NULL, 0);
 		prod = strtol(devicestr, NULL, 0);
 		bus = BUS_PCI;
-	} else if (strcmp(parentname, "atkbdc0") == 0) {
+	} else if (strcmp(nd->parent, "atkbdc0") == 0) {
 		if (strcmp(devname, "atkbd") == 0) {
 			vendor = PS2_KEYBOARD_VENDOR;
 			prod = PS2_KEYBOARD_PRODUCT;
@@ -562,8 +823,41 @@ set_parent(struct udev_device *ud)
 		prod = 0;
 		bus = BUS_VIRTUAL;
 	}
-	snprintf(product, sizeof(product), "%x/%x/%x/0", bus, vendor, prod);
-	parent = create_xorg_parent(ud, sysname, name, product, pnp_id);
+	snprintf(nd->product, sizeof(nd->product), "%x/%x/%x/0", bus, vendor,
+	    prod);
+
+	return (0);
+}
+
+void
+set_parent(struct udev_device *ud)
+{
+        struct udev_device *parent;
+	struct newbus_desc nd;
+	char devname[DEV_PATH_MAX];
+	const char *sysname, *unit;
+	size_t len;
+	struct udev *udev;
+
+	udev = udev_device_get_udev(ud);
+	sysname = udev_device_get_sysname(ud);
+	len = syspathlen_wo_units(sysname);
+	/* Check if device unit number found */
+	if (strlen(sysname) == len)
+		return;
+	snprintf(devname, len + 1, "%s", sysname);
+	unit = sysname + len;
+
+	/* Descriptor lives until probe pass ends or devd reports the device */
+	if (_udev_snapshot_get(udev, "newbus", sysname, &nd, sizeof(nd)) < 0) {
+		if (get_newbus_desc(_udev_get_backend(udev), devname, unit,
+		    &nd) < 0)
+			return;
+		_udev_snapshot_put(udev, "newbus", sysname, &nd, sizeof(nd));
+	}
+
+	parent = create_xorg_parent(ud, sysname, nd.name, nd.product,
+	    nd.pnp_id[0] != '\0' ? nd.pnp_id : NULL);
 	if (parent != NULL)
 		udev_device_set_parent(ud, parent);
 
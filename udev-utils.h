@@ -2,6 +2,7 @@
 #define UDEV_UTILS_H_
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -15,7 +16,12 @@
 
 #define	UNKNOWN_SUBSYSTEM	"#"
 
-const char *get_subsystem_by_syspath(const char *syspath);
+int get_subsystem_config_index(const char *syspath);
+const char *get_subsystem_by_index(struct udev *udev, int idx);
+int get_subsystem_index_by_syspath(struct udev *udev, const char *syspath);
+uint32_t get_subsystem_mask(const char *pattern);
+int get_syspath_by_subsystem_sysname(struct udev *udev,
+    const char *subsystem, const char *sysname, char *syspath, size_t len);
 const char *get_sysname_by_syspath(const char *syspath);
 const char *get_devpath_by_syspath(const char *syspath);
 const char *get_syspath_by_devpath(const char *devpath);
@@ -27,18 +27,114 @@
 #include "config.h"
 #include "libudev.h"
 #include "udev.h"
+#include "udev-backend.h"
+#include "udev-device.h"
 #include "udev-utils.h"
 #include "utils.h"
 
+#include <sys/types.h>
+#include <sys/queue.h>
+#include <sys/tree.h>
+
+#include <pthread.h>
 #include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/*
+ * Device cached by syspath. Cache holds a reference to the device while
+ * the udev reference owned by device is lent back to the context, so
+ * cached devices do not keep the context alive.
+ *
+ * Cached devices are dropped on devd events only while a monitor of the
+ * context is receiving. Without one, stale devices are evicted solely by
+ * the LRU once cache size is exceeded or by udev_trim_device_cache().
+ */
+struct udev_cache_entry {
+	RB_ENTRY(udev_cache_entry) link;
+	TAILQ_ENTRY(udev_cache_entry) lru;
+	const char *syspath;
+	struct udev_device *ud;
+	const void *owner;	/* holder of device kept for claiming */
+};
+
+static int udev_cache_entry_cmp(struct udev_cache_entry *uce1,
+    struct udev_cache_entry *uce2);
+
+RB_HEAD(udev_cache, udev_cache_entry);
+RB_PROTOTYPE_STATIC(udev_cache, udev_cache_entry, link, udev_cache_entry_cmp);
+TAILQ_HEAD(udev_cache_lru, udev_cache_entry);
+
+/*
+ * Device node resolved by udev_device_new_from_devnum(). Indexed by both
+ * devnum and syspath, each one maps to a single entry.
+ */
+struct udev_devnum {
+	RB_ENTRY(udev_devnum) link;
+	RB_ENTRY(udev_devnum) path_link;
+	dev_t devnum;
+	char pci_id[32];
+	char syspath[];
+};
+
+static int udev_devnum_cmp(struct udev_devnum *udn1, struct udev_devnum *udn2);
+static int udev_devnum_path_cmp(struct udev_devnum *udn1,
+    struct udev_devnum *udn2);
+
+RB_HEAD(udev_devnum_index, udev_devnum);
+RB_PROTOTYPE_STATIC(udev_devnum_index, udev_devnum, link, udev_devnum_cmp);
+RB_HEAD(udev_devnum_paths, udev_devnum);
+RB_PROTOTYPE_STATIC(udev_devnum_paths, udev_devnum, path_link,
+    udev_devnum_path_cmp);
+
+/*
+ * Probe results of device named sysname. They are not matched against
+ * the system, so snapshots are kept only while a probe pass, such as an
+ * enumeration scan, is running and are dropped when the last one ends or
+ * when devd reports an event for the device.
+ */
+#define	UDEV_SNAPSHOT_MAX	256
+
+struct udev_snapshot {
+	RB_ENTRY(udev_snapshot) link;
+	const char *type;	/* kind of probe results */
+	size_t len;
+	unsigned char *data;
+	char sysname[];
+};
+
+static int udev_snapshot_cmp(struct udev_snapshot *us1,
+    struct udev_snapshot *us2);
+
+RB_HEAD(udev_snapshots, udev_snapshot);
+RB_PROTOTYPE_STATIC(udev_snapshots, udev_snapshot, link, udev_snapshot_cmp);
 
 struct udev {
 	_Atomic(int) refcount;
 	void *userdata;
+	struct udev_backend *backend;
+	pthread_mutex_t cache_mtx;
+	struct udev_cache cache;
+	struct udev_cache_lru cache_lru;	/* most recently used first */
+	int cache_count;
+	_Atomic(int) cache_size;	/* 0 disables cache */
+	struct udev_cache held;		/* protected by cache_mtx */
+	_Atomic(int) held_count;
+	struct udev_devnum_index devnums;	/* protected by cache_mtx */
+	struct udev_devnum_paths devnum_paths;	/* protected by cache_mtx */
+	struct udev_snapshots snapshots;	/* protected by cache_mtx */
+	int snapshot_count;
+	_Atomic(int) snapshot_passes;	/* changed under cache_mtx */
+	pthread_mutex_t probe_mtx;	/* waits for probes of devices */
+	pthread_cond_t probe_cv;
 };
 
+static void udev_cache_flush(struct udev *udev, int keep);
+static void udev_devnum_unlink(struct udev *udev, struct udev_devnum *udn);
+static void udev_snapshot_flush_locked(struct udev *udev, const char *sysname);
+
 LIBUDEV_EXPORT struct udev *
 udev_new(void)
 {
@@ -47,8 +143,27 @@ udev_new(void)
 	TRC();
 	udev = calloc(1, sizeof(struct udev));
 	if (udev) {
+		udev->backend = udev_backend_new();
+		if (udev->backend == NULL) {
+			free(udev);
+			return (NULL);
+		}
 		atomic_init(&udev->refcount, 1);
 		udev->userdata = NULL;
+		pthread_mutex_init(&udev->cache_mtx, NULL);
+		RB_INIT(&udev->cache);
+		TAILQ_INIT(&udev->cache_lru);
+		udev->cache_count = 0;
+		atomic_init(&udev->cache_size, 0);
+		RB_INIT(&udev->held);
+		atomic_init(&udev->held_count, 0);
+		RB_INIT(&udev->devnums);
+		RB_INIT(&udev->devnum_paths);
+		RB_INIT(&udev->snapshots);
+		udev->snapshot_count = 0;
+		atomic_init(&udev->snapshot_passes, 0);
+		pthread_mutex_init(&udev->probe_mtx, NULL);
+		pthread_cond_init(&udev->probe_cv, NULL);
 	}
 
 	return (udev);
@@ -73,9 +188,499 @@ udev_ref(struct udev *udev)
 void
 _udev_unref(struct udev *udev)
 {
+	struct udev_devnum *udn1, *udn2;
 
-	if (atomic_fetch_sub(&udev->refcount, 1) == 1)
+	if (atomic_fetch_sub(&udev->refcount, 1) == 1) {
+		/* Cached devices may still be referenced by application */
+		if (udev->cache_count != 0) {
+			udev_cache_flush(udev, 0);
+			return;
+		}
+		RB_FOREACH_SAFE(udn1, udev_devnum_index, &udev->devnums, udn2) {
+			udev_devnum_unlink(udev, udn1);
+			free(udn1);
+		}
+		_udev_snapshot_flush(udev, NULL);
+		udev_backend_free(udev->backend);
+		pthread_mutex_destroy(&udev->cache_mtx);
+		pthread_cond_destroy(&udev->probe_cv);
+		pthread_mutex_destroy(&udev->probe_mtx);
 		free(udev);
+	}
+}
+
+struct udev_backend *
+_udev_get_backend(struct udev *udev)
+{
+
+	return (udev->backend);
+}
+
+/* Returns referenced device cached for syspath or NULL */
+struct udev_device *
+_udev_cache_get(struct udev *udev, const char *syspath)
+{
+	struct udev_cache_entry key, *uce;
+	struct udev_device *ud = NULL;
+
+	if (atomic_load(&udev->cache_size) == 0)
+		return (NULL);
+
+	key.syspath = syspath;
+	pthread_mutex_lock(&udev->cache_mtx);
+	uce = RB_FIND(udev_cache, &udev->cache, &key);
+	if (uce != NULL) {
+		TAILQ_REMOVE(&udev->cache_lru, uce, lru);
+		TAILQ_INSERT_HEAD(&udev->cache_lru, uce, lru);
+		ud = udev_device_ref(uce->ud);
+	}
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	return (ud);
+}
+
+/* Caches device by its syspath. Returns -1 if device is not cached */
+int
+_udev_cache_put(struct udev *udev, struct udev_device *ud)
+{
+	struct udev_cache_entry *uce;
+
+	if (atomic_load(&udev->cache_size) == 0)
+		return (-1);
+
+	uce = malloc(sizeof(struct udev_cache_entry));
+	if (uce == NULL)
+		return (-1);
+	uce->syspath = udev_device_get_syspath(ud);
+	uce->ud = ud;
+
+	pthread_mutex_lock(&udev->cache_mtx);
+	if (RB_INSERT(udev_cache, &udev->cache, uce) != NULL) {
+		pthread_mutex_unlock(&udev->cache_mtx);
+		free(uce);
+		return (-1);
+	}
+	TAILQ_INSERT_HEAD(&udev->cache_lru, uce, lru);
+	udev_device_ref(ud);
+	atomic_fetch_sub(&udev->refcount, 1);
+	udev->cache_count++;
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	udev_cache_flush(udev, atomic_load(&udev->cache_size));
+	return (0);
+}
+
+/*
+ * Keeps device probed by owner, e.g. for enumeration filtering, so the
+ * first udev_device_new_from_syspath() call for its syspath takes it over
+ * instead of probing again. Returns -1 if device is not kept.
+ */
+int
+_udev_cache_hold(struct udev *udev, struct udev_device *ud, const void *owner)
+{
+	struct udev_cache_entry *uce;
+
+	uce = malloc(sizeof(struct udev_cache_entry));
+	if (uce == NULL)
+		return (-1);
+	uce->syspath = udev_device_get_syspath(ud);
+	uce->ud = ud;
+	uce->owner = owner;
+
+	pthread_mutex_lock(&udev->cache_mtx);
+	if (RB_INSERT(udev_cache, &udev->held, uce) != NULL) {
+		pthread_mutex_unlock(&udev->cache_mtx);
+		free(uce);
+		return (-1);
+	}
+	atomic_fetch_add(&udev->held_count, 1);
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	return (0);
+}
+
+/* Hands device held for syspath over to the caller. Returns NULL if none */
+struct udev_device *
+_udev_cache_claim(struct udev *udev, const char *syspath)
+{
+	struct udev_cache_entry key, *uce;
+	struct udev_device *ud = NULL;
+
+	if (atomic_load(&udev->held_count) == 0)
+		return (NULL);
+
+	key.syspath = syspath;
+	pthread_mutex_lock(&udev->cache_mtx);
+	uce = RB_FIND(udev_cache, &udev->held, &key);
+	if (uce != NULL) {
+		RB_REMOVE(udev_cache, &udev->held, uce);
+		atomic_fetch_sub(&udev->held_count, 1);
+	}
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	if (uce != NULL) {
+		ud = uce->ud;
+		free(uce);
+	}
+	return (ud);
+}
+
+/* Drops device held for syspath by owner if nobody claimed it */
+void
+_udev_cache_release(struct udev *udev, const char *syspath, const void *owner)
+{
+	struct udev_cache_entry key, *uce;
+
+	if (atomic_load(&udev->held_count) == 0)
+		return;
+
+	key.syspath = syspath;
+	pthread_mutex_lock(&udev->cache_mtx);
+	uce = RB_FIND(udev_cache, &udev->held, &key);
+	if (uce != NULL && uce->owner == owner) {
+		RB_REMOVE(udev_cache, &udev->held, uce);
+		atomic_fetch_sub(&udev->held_count, 1);
+	} else
+		uce = NULL;
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	if (uce != NULL) {
+		udev_device_unref(uce->ud);
+		free(uce);
+	}
+}
+
+/* Looks device node up by syspath. Called with cache_mtx held */
+static struct udev_devnum *
+udev_devnum_find_path(struct udev *udev, const char *syspath)
+{
+	struct udev_devnum *udn;
+	int cmp;
+
+	udn = RB_ROOT(&udev->devnum_paths);
+	while (udn != NULL) {
+		cmp = strcmp(syspath, udn->syspath);
+		if (cmp == 0)
+			break;
+		udn = cmp < 0 ?
+		    RB_LEFT(udn, path_link) : RB_RIGHT(udn, path_link);
+	}
+
+	return (udn);
+}
+
+/* Removes device node from both indexes. Called with cache_mtx held */
+static void
+udev_devnum_unlink(struct udev *udev, struct udev_devnum *udn)
+{
+
+	RB_REMOVE(udev_devnum_index, &udev->devnums, udn);
+	RB_REMOVE(udev_devnum_paths, &udev->devnum_paths, udn);
+}
+
+/*
+ * Drops device, held device, device node and snapshots cached for syspath
+ * as they are stale. Backend is reset too, as the application may open
+ * or close device nodes in response to the event.
+ */
+void
+_udev_cache_invalidate(struct udev *udev, const char *syspath)
+{
+	struct udev_cache_entry key, *uce, *held;
+	struct udev_devnum *udn;
+
+	udev_backend_reset(udev->backend);
+	_udev_snapshot_flush(udev, get_sysname_by_syspath(syspath));
+	key.syspath = syspath;
+	pthread_mutex_lock(&udev->cache_mtx);
+	udn = udev_devnum_find_path(udev, syspath);
+	if (udn != NULL)
+		udev_devnum_unlink(udev, udn);
+	uce = RB_FIND(udev_cache, &udev->cache, &key);
+	if (uce != NULL) {
+		RB_REMOVE(udev_cache, &udev->cache, uce);
+		TAILQ_REMOVE(&udev->cache_lru, uce, lru);
+		udev->cache_count--;
+		atomic_fetch_add(&udev->refcount, 1);
+	}
+	held = RB_FIND(udev_cache, &udev->held, &key);
+	if (held != NULL) {
+		RB_REMOVE(udev_cache, &udev->held, held);
+		atomic_fetch_sub(&udev->held_count, 1);
+	}
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	free(udn);
+	if (uce != NULL) {
+		udev_device_unref(uce->ud);
+		free(uce);
+	}
+	if (held != NULL) {
+		udev_device_unref(held->ud);
+		free(held);
+	}
+}
+
+/*
+ * Looks syspath and PCI_ID of device node up. Returns -1 if devnum is not
+ * known. Found entry may be stale if no monitor is active, so caller has
+ * to recheck it.
+ */
+int
+_udev_devnum_lookup(struct udev *udev, dev_t devnum, char *syspath,
+    size_t len, char *pci_id, size_t idlen)
+{
+	struct udev_devnum key, *udn;
+
+	key.devnum = devnum;
+	pthread_mutex_lock(&udev->cache_mtx);
+	udn = RB_FIND(udev_devnum_index, &udev->devnums, &key);
+	if (udn != NULL) {
+		strlcpy(syspath, udn->syspath, len);
+		strlcpy(pci_id, udn->pci_id, idlen);
+	}
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	return (udn != NULL ? 0 : -1);
+}
+
+void
+_udev_devnum_insert(struct udev *udev, dev_t devnum, const char *syspath,
+    const char *pci_id)
+{
+	struct udev_devnum *udn, *old_udn, *old_path;
+
+	udn = malloc(offsetof(struct udev_devnum, syspath) +
+	    strlen(syspath) + 1);
+	if (udn == NULL)
+		return;
+	udn->devnum = devnum;
+	strlcpy(udn->pci_id, pci_id, sizeof(udn->pci_id));
+	strcpy(udn->syspath, syspath);
+
+	pthread_mutex_lock(&udev->cache_mtx);
+	old_udn = RB_FIND(udev_devnum_index, &udev->devnums, udn);
+	if (old_udn != NULL)
+		udev_devnum_unlink(udev, old_udn);
+	old_path = RB_FIND(udev_devnum_paths, &udev->devnum_paths, udn);
+	if (old_path != NULL)
+		udev_devnum_unlink(udev, old_path);
+	RB_INSERT(udev_devnum_index, &udev->devnums, udn);
+	RB_INSERT(udev_devnum_paths, &udev->devnum_paths, udn);
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	free(old_udn);
+	free(old_path);
+}
+
+void
+_udev_devnum_remove(struct udev *udev, dev_t devnum)
+{
+	struct udev_devnum key, *udn;
+
+	key.devnum = devnum;
+	pthread_mutex_lock(&udev->cache_mtx);
+	udn = RB_FIND(udev_devnum_index, &udev->devnums, &key);
+	if (udn != NULL)
+		udev_devnum_unlink(udev, udn);
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	free(udn);
+}
+
+/* Copies len bytes of type stored for sysname to buf. Returns -1 if none */
+int
+_udev_snapshot_get(struct udev *udev, const char *type, const char *sysname,
+    void *buf, size_t len)
+{
+	struct udev_snapshot *us;
+	int cmp, ret = -1;
+
+	/* Snapshots are dropped when the last probe pass ends */
+	if (atomic_load(&udev->snapshot_passes) == 0)
+		return (-1);
+
+	pthread_mutex_lock(&udev->cache_mtx);
+	us = RB_ROOT(&udev->snapshots);
+	while (us != NULL) {
+		cmp = strcmp(sysname, us->sysname);
+		if (cmp == 0)
+			cmp = strcmp(type, us->type);
+		if (cmp == 0)
+			break;
+		us = cmp < 0 ? RB_LEFT(us, link) : RB_RIGHT(us, link);
+	}
+	if (us != NULL && us->len == len) {
+		memcpy(buf, us->data, len);
+		ret = 0;
+	}
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	return (ret);
+}
+
+/* type must be a string constant */
+void
+_udev_snapshot_put(struct udev *udev, const char *type, const char *sysname,
+    const void *buf, size_t len)
+{
+	struct udev_snapshot *us, *old_us;
+	size_t namelen;
+
+	if (atomic_load(&udev->snapshot_passes) == 0)
+		return;
+
+	namelen = strlen(sysname) + 1;
+	us = malloc(offsetof(struct udev_snapshot, sysname) + namelen + len);
+	if (us == NULL)
+		return;
+	memcpy(us->sysname, sysname, namelen);
+	us->type = type;
+	us->data = (unsigned char *)us->sysname + namelen;
+	us->len = len;
+	memcpy(us->data, buf, len);
+
+	pthread_mutex_lock(&udev->cache_mtx);
+	if (atomic_load(&udev->snapshot_passes) == 0) {
+		pthread_mutex_unlock(&udev->cache_mtx);
+		free(us);
+		return;
+	}
+	if (udev->snapshot_count >= UDEV_SNAPSHOT_MAX)
+		udev_snapshot_flush_locked(udev, NULL);
+	old_us = RB_FIND(udev_snapshots, &udev->snapshots, us);
+	if (old_us != NULL) {
+		RB_REMOVE(udev_snapshots, &udev->snapshots, old_us);
+		udev->snapshot_count--;
+	}
+	RB_INSERT(udev_snapshots, &udev->snapshots, us);
+	udev->snapshot_count++;
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	free(old_us);
+}
+
+/* Starts probe pass. Snapshots are taken only within probe passes */
+void
+_udev_snapshot_begin(struct udev *udev)
+{
+
+	udev_backend_reset(udev->backend);
+	pthread_mutex_lock(&udev->cache_mtx);
+	atomic_fetch_add(&udev->snapshot_passes, 1);
+	pthread_mutex_unlock(&udev->cache_mtx);
+}
+
+/* Ends probe pass. Snapshots are dropped with the last running pass */
+void
+_udev_snapshot_end(struct udev *udev)
+{
+
+	pthread_mutex_lock(&udev->cache_mtx);
+	if (atomic_fetch_sub(&udev->snapshot_passes, 1) == 1)
+		udev_snapshot_flush_locked(udev, NULL);
+	pthread_mutex_unlock(&udev->cache_mtx);
+}
+
+static void
+udev_snapshot_flush_locked(struct udev *udev, const char *sysname)
+{
+	struct udev_snapshot *us1, *us2;
+
+	RB_FOREACH_SAFE(us1, udev_snapshots, &udev->snapshots, us2) {
+		if (sysname != NULL && strcmp(us1->sysname, sysname) != 0)
+			continue;
+		RB_REMOVE(udev_snapshots, &udev->snapshots, us1);
+		udev->snapshot_count--;
+		free(us1);
+	}
+}
+
+/* Drops snapshots of sysname or all of them if sysname is NULL */
+void
+_udev_snapshot_flush(struct udev *udev, const char *sysname)
+{
+
+	pthread_mutex_lock(&udev->cache_mtx);
+	udev_snapshot_flush_locked(udev, sysname);
+	pthread_mutex_unlock(&udev->cache_mtx);
+}
+
+/*
+ * Sleeps until probe running in another thread is published. Devices
+ * share the context lock for waits, so they need no lock of their own.
+ */
+void
+_udev_probe_wait(struct udev *udev, _Atomic(int) *state)
+{
+	int running = UD_PROBE_RUNNING;
+
+	pthread_mutex_lock(&udev->probe_mtx);
+	atomic_compare_exchange_strong(state, &running, UD_PROBE_WAITED);
+	while (atomic_load(state) != UD_PROBE_DONE)
+		pthread_cond_wait(&udev->probe_cv, &udev->probe_mtx);
+	pthread_mutex_unlock(&udev->probe_mtx);
+}
+
+/* Wakes threads waiting for probes once one they wait for is published */
+void
+_udev_probe_wakeup(struct udev *udev)
+{
+
+	pthread_mutex_lock(&udev->probe_mtx);
+	pthread_cond_broadcast(&udev->probe_cv);
+	pthread_mutex_unlock(&udev->probe_mtx);
+}
+
+/*
+ * Evicts least recently used devices until keep ones are left. Evicted
+ * devices get their udev reference back before they are released.
+ */
+static void
+udev_cache_flush(struct udev *udev, int keep)
+{
+	struct udev_cache_lru evicted;
+	struct udev_cache_entry *uce;
+
+	TAILQ_INIT(&evicted);
+	pthread_mutex_lock(&udev->cache_mtx);
+	while (udev->cache_count > keep) {
+		uce = TAILQ_LAST(&udev->cache_lru, udev_cache_lru);
+		RB_REMOVE(udev_cache, &udev->cache, uce);
+		TAILQ_REMOVE(&udev->cache_lru, uce, lru);
+		TAILQ_INSERT_TAIL(&evicted, uce, lru);
+		udev->cache_count--;
+		atomic_fetch_add(&udev->refcount, 1);
+	}
+	pthread_mutex_unlock(&udev->cache_mtx);
+
+	/* Context may be freed with the last device */
+	while ((uce = TAILQ_FIRST(&evicted)) != NULL) {
+		TAILQ_REMOVE(&evicted, uce, lru);
+		udev_device_unref(uce->ud);
+		free(uce);
+	}
+}
+
+LIBUDEV_EXPORT int
+udev_set_device_cache_size(struct udev *udev, int size)
+{
+
+	TRC("(%p, %d)", udev, size);
+	if (size < 0)
+		return (-1);
+
+	atomic_store(&udev->cache_size, size);
+	udev_cache_flush(udev, size);
+	return (0);
+}
+
+LIBUDEV_EXPORT void
+udev_trim_device_cache(struct udev *udev)
+{
+
+	TRC("(%p)", udev);
+	udev_cache_flush(udev, 0);
 }
 
 LIBUDEV_EXPORT void
@@ -109,3 +714,44 @@ udev_set_userdata(struct udev *udev, void *userdata)
 	TRC();
 	udev->userdata = userdata;
 }
+
+static int
+udev_cache_entry_cmp(struct udev_cache_entry *uce1,
+    struct udev_cache_entry *uce2)
+{
+
+	return (strcmp(uce1->syspath, uce2->syspath));
+}
+
+RB_GENERATE_STATIC(udev_cache, udev_cache_entry, link, udev_cache_entry_cmp);
+
+static int
+udev_devnum_cmp(struct udev_devnum *udn1, struct udev_devnum *udn2)
+{
+
+	return (udn1->devnum < udn2->devnum ? -1 : udn1->devnum > udn2->devnum);
+}
+
+RB_GENERATE_STATIC(udev_devnum_index, udev_devnum, link, udev_devnum_cmp);
+
+static int
+udev_devnum_path_cmp(struct udev_devnum *udn1, struct udev_devnum *udn2)
+{
+
+	return (strcmp(udn1->syspath, udn2->syspath));
+}
+
+RB_GENERATE_STATIC(udev_devnum_paths, udev_devnum, path_link,
+    udev_devnum_path_cmp);
+
+static int
+udev_snapshot_cmp(struct udev_snapshot *us1, struct udev_snapshot *us2)
+{
+
+	int cmp;
+
+	cmp = strcmp(us1->sysname, us2->sysname);
+	return (cmp != 0 ? cmp : strcmp(us1->type, us2->type));
+}
+
+RB_GENERATE_STATIC(udev_snapshots, udev_snapshot, link, udev_snapshot_cmp);
@@ -5,5 +5,28 @@
 
 struct udev *_udev_ref(struct udev *udev);
 void _udev_unref(struct udev *udev);
+struct udev_backend *_udev_get_backend(struct udev *udev);
+struct udev_device *_udev_cache_get(struct udev *udev, const char *syspath);
+int _udev_cache_put(struct udev *udev, struct udev_device *ud);
+int _udev_cache_hold(struct udev *udev, struct udev_device *ud,
+    const void *owner);
+struct udev_device *_udev_cache_claim(struct udev *udev, const char *syspath);
+void _udev_cache_release(struct udev *udev, const char *syspath,
+    const void *owner);
+void _udev_cache_invalidate(struct udev *udev, const char *syspath);
+int _udev_devnum_lookup(struct udev *udev, dev_t devnum, char *syspath,
+    size_t len, char *pci_id, size_t idlen);
+void _udev_devnum_insert(struct udev *udev, dev_t devnum, const char *syspath,
+    const char *pci_id);
+void _udev_devnum_remove(struct udev *udev, dev_t devnum);
+int _udev_snapshot_get(struct udev *udev, const char *type,
+    const char *sysname, void *buf, size_t len);
+void _udev_snapshot_put(struct udev *udev, const char *type,
+    const char *sysname, const void *buf, size_t len);
+void _udev_snapshot_begin(struct udev *udev);
+void _udev_snapshot_end(struct udev *udev);
+void _udev_snapshot_flush(struct udev *udev, const char *sysname);
+void _udev_probe_wait(struct udev *udev, _Atomic(int) *state);
+void _udev_probe_wakeup(struct udev *udev);
 
 #endif /* UDEV_H_ */
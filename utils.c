@@ -32,6 +32,8 @@
 #include <sys/un.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -41,10 +43,15 @@
 #include <sys/queue.h>
 #include <sys/socket.h>
 #include <kvm.h>
+#include <limits.h>
 #include <libprocstat.h>
 #else
-#include <sys/stat.h>
+#include <sys/param.h>
+#ifdef HAVE_SYS_SYSCTL_H
+#include <sys/sysctl.h>
+#endif
 #endif
+#include <sys/stat.h>
 
 #ifdef HAVE_DEVINFO_H
 #include <devinfo.h>
@@ -52,24 +59,21 @@
 static pthread_mutex_t devinfo_mtx = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
-#ifndef HAVE_PIPE2
-#include <fcntl.h>
-#endif
-
 int
-socket_connect(const char *path)
+socket_connect(const char *path, int type)
 {
 	struct sockaddr_un sa;
 	int fd;
 
-	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
 	if (fd < 0)
                 return (-1);
 
 	sa.sun_family = AF_UNIX;
 	strlcpy(sa.sun_path, path, sizeof(sa.sun_path));
 
-	if (connect(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+	if (connect(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0 ||
+	    fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
 		close(fd);
 		return (-1);
 	}
@@ -77,21 +81,153 @@ socket_connect(const char *path)
 	return (fd);
 }
 
+void
+socket_buf_init(struct socket_buf *sb, int type)
+{
+
+	sb->type = type;
+	sb->discard = false;
+	sb->stalled = false;
+	sb->len = 0;
+}
+
+/*
+ * Calls cb for complete lines kept in sb until it refuses one. Refused
+ * line and the rest of the buffer stay in sb. Returns false on refusal.
+ */
+static bool
+socket_buf_drain(struct socket_buf *sb, line_cb_t cb, void *args,
+    ssize_t *nlines)
+{
+	char *line, *eol, *end;
+	bool ret = true;
+
+	end = sb->buf + sb->len;
+	*end = '\0';
+	for (line = sb->buf; ; line = eol + 1) {
+		/* Lines are terminated with either newline or zero */
+		eol = line + strcspn(line, "\n");
+		if (eol == end)
+			break;
+		*eol = '\0';
+		if (sb->discard)
+			sb->discard = false;
+		else if (*line != '\0') {
+			if (!cb(line, args)) {
+				ret = false;
+				break;
+			}
+			++*nlines;
+		}
+	}
+
+	sb->stalled = !ret;
+	sb->len = end - line;
+	memmove(sb->buf, line, sb->len);
+	return (ret);
+}
+
+/*
+ * Drains non-blocking socket fd and calls cb for every complete line.
+ * Trailing partial line is kept in sb until the rest of it arrives. When
+ * cb refuses a line, reading stops and unprocessed data is left in sb and
+ * in the socket for the next call. Returns number of lines processed or
+ * -1 on EOF or error.
+ */
 ssize_t
-socket_readline(int fd, char *buf, size_t len)
+socket_readlines(int fd, struct socket_buf *sb, line_cb_t cb, void *args)
 {
-	size_t pos;
+	ssize_t nlines, n;
+	char *end;
+
+	nlines = 0;
+	for (;;) {
+		if (!socket_buf_drain(sb, cb, args, &nlines))
+			return (nlines);
+
+		if (sb->len == sizeof(sb->buf) - 2) {
+			/* Line does not fit in the buffer. Drop it */
+			sb->discard = true;
+			sb->len = 0;
+		}
 
-	for (pos = 0; pos < len; ++pos) {
-		if (read(fd, buf + pos, 1) < 1)
+		/* Keep room for message terminator and zero */
+		n = read(fd, sb->buf + sb->len, sizeof(sb->buf) - sb->len - 2);
+		if (n == 0)
 			return (-1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return (nlines);
+			return (-1);
+		}
 
-		if (buf[pos] == 0 || buf[pos] == '\n') {
-			buf[pos] = 0;
-			return (pos);
+		sb->len += n;
+		end = sb->buf + sb->len;
+		/* Every SOCK_SEQPACKET message ends a line */
+		if (sb->type == SOCK_SEQPACKET && end[-1] != '\n' &&
+		    end[-1] != '\0') {
+			*end = '\n';
+			sb->len++;
 		}
 	}
-	return (-1);
+}
+
+void
+arena_init(struct arena *a)
+{
+
+	a->chunks = NULL;
+}
+
+/* Returns zeroed memory carved from the current chunk or from a new one */
+void *
+arena_alloc(struct arena *a, size_t size)
+{
+	struct arena_chunk *ac;
+	size_t chunk_size;
+	void *ptr;
+
+	size = (size + _Alignof(max_align_t) - 1) &
+	    ~(_Alignof(max_align_t) - 1);
+	ac = a->chunks;
+	if (ac == NULL || ac->size - ac->used < size) {
+		chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+		ac = malloc(offsetof(struct arena_chunk, data) + chunk_size);
+		if (ac == NULL)
+			return (NULL);
+		ac->size = chunk_size;
+		ac->used = 0;
+		/* Keep partially used chunk on top for small allocations */
+		if (a->chunks != NULL && size > ARENA_CHUNK_SIZE) {
+			ac->next = a->chunks->next;
+			a->chunks->next = ac;
+		} else {
+			ac->next = a->chunks;
+			a->chunks = ac;
+		}
+	}
+
+	ptr = (char *)ac->data + ac->used;
+	ac->used += size;
+	memset(ptr, 0, size);
+	return (ptr);
+}
+
+/* Releases all chunks. The arena can be used again after that */
+void
+arena_free(struct arena *a)
+{
+	struct arena_chunk *ac1, *ac2;
+
+	ac1 = a->chunks;
+	while (ac1 != NULL) {
+		ac2 = ac1->next;
+		free(ac1);
+		ac1 = ac2;
+	}
+	a->chunks = NULL;
 }
 
 /*
@@ -143,23 +279,25 @@ match_kern_prop_value(const char *buf, const char *prop,
 	return (0);
 }
 
+/*
+ * Calls cb for every descriptor of the process open on character device.
+ * Descriptor table may be sparse and large, so it is not probed blindly
+ * when the list of open descriptors can be had from the kernel. Device
+ * numbers then come with the list and descriptors are not stat()ed.
+ */
 int
-path_to_fd(const char *path)
+scan_fds(fd_cb_t cb, void *args)
 {
-	int fd = -1;
-
 #ifdef HAVE_LIBPROCSTAT_H
 	struct procstat *procstat;
 	struct kinfo_proc *kip;
 	struct filestat_list *head = NULL;
 	struct filestat *fst;
+	struct vnstat vn;
+	char errbuf[_POSIX2_LINE_MAX];
 	unsigned int count;
-#else
-	struct stat st, fst;
-#define	MAX_FD	128
-#endif
+	int ret = -1;
 
-#ifdef HAVE_LIBPROCSTAT_H
 	procstat = procstat_open_sysctl();
 	if (procstat == NULL)
 		return (-1);
@@ -176,12 +314,11 @@ path_to_fd(const char *path)
 	STAILQ_FOREACH(fst, head, next) {
 		if (fst->fs_uflags == 0 &&
 		    fst->fs_type == PS_FST_TYPE_VNODE &&
-		    fst->fs_path != NULL &&
-		    strcmp(fst->fs_path, path) == 0) {
-			fd = fst->fs_fd;
-			break;
-		}
+		    procstat_get_vnode_info(procstat, fst, &vn, errbuf) == 0 &&
+		    vn.vn_type == PS_FST_VTYPE_VCHR)
+			cb(fst->fs_fd, (dev_t)vn.vn_dev, args);
 	}
+	ret = 0;
 
 out:
 	if (head != NULL)
@@ -189,29 +326,35 @@ out:
 	if (kip != NULL)
 		procstat_freeprocs(procstat, kip);
 	procstat_close(procstat);
-#else
-	if (stat(path, &st) != 0)
-		return (-1);
 
-	for (fd = 0; fd < MAX_FD; ++fd) {
+	return (ret);
+#else
+	struct stat st;
+	int fd, maxfd, nfds;
+#ifdef KERN_PROC_NFDS
+	int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_NFDS, 0 };
+	size_t len = sizeof(nfds);
+
+	/* Stop as soon as all open descriptors have been seen */
+	if (sysctl(mib, nitems(mib), &nfds, &len, NULL, 0) != 0)
+#endif
+		nfds = -1;
 
-		if (fstat(fd, &fst) != 0) {
-			if (errno != EBADF) {
-				return -1;
-			} else {
-				continue;
-			}
+	maxfd = getdtablesize();
+	for (fd = 0; fd < maxfd && nfds != 0; fd++) {
+		if (fstat(fd, &st) != 0) {
+			if (errno != EBADF)
+				return (-1);
+			continue;
 		}
-
-		if (fst.st_rdev == st.st_rdev)
-			break;
+		if (nfds > 0)
+			nfds--;
+		if (S_ISCHR(st.st_mode))
+			cb(fd, st.st_rdev, args);
 	}
 
-	if (fd == MAX_FD)
-		return (-1);
+	return (0);
 #endif
-
-	return (fd);
 }
 
 static int
@@ -348,3 +491,22 @@ strchrnul(const char *p, int ch)
 	/* NOTREACHED */
 }
 #endif /* !HAVE_STRCHRNUL */
+
+#ifndef HAVE_STRLCPY
+size_t
+strlcpy(char *dst, const char *src, size_t dsize)
+{
+	size_t len;
+
+	len = strlen(src);
+	if (dsize != 0) {
+		if (len >= dsize)
+			dsize--;
+		else
+			dsize = len;
+		memcpy(dst, src, dsize);
+		dst[dsize] = '\0';
+	}
+	return (len);
+}
+#endif /* !HAVE_STRLCPY */
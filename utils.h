@@ -1,10 +1,20 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <sys/param.h>
+#include <sys/types.h>
+
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <unistd.h>
 
+#ifndef nitems
+#define	nitems(x)	(sizeof((x)) / sizeof((x)[0]))
+#endif
+#ifndef __unused
+#define	__unused	__attribute__((__unused__))
+#endif
 
 /* #define	ENABLE_TRACE */
 #define	LOG_LEVEL       0
@@ -40,6 +50,8 @@ do {									\
 #define	UNIMPL()	ERR("%s is unimplemented", __FUNCTION__)
 
 typedef int (* scan_cb_t) (const char *path, int type, void *args);
+typedef bool (* line_cb_t) (char *line, void *args);
+typedef void (* fd_cb_t) (int fd, dev_t rdev, void *args);
 
 /* If .recursive is true, then .cb gets called for non-dir
  * paths, an the overall scandir is recursive. If .recursive
@@ -52,12 +64,44 @@ struct scan_ctx {
 	void *args;
 };
 
+#define	SOCKET_BUF_SIZE	4096
+
+/* Reassembly buffer for line oriented sockets. SOCK_SEQPACKET sockets
+ * preserve message boundaries, so every read there ends a line.
+ */
+struct socket_buf {
+	int type;
+	bool discard;	/* skipping the rest of an overlong line */
+	bool stalled;	/* callback refused a line kept in buf */
+	size_t len;	/* length of the partial line kept in buf */
+	char buf[SOCKET_BUF_SIZE];
+};
+
+#define	ARENA_CHUNK_SIZE	512
+
+/* Bump allocator. Memory is released for all allocations at once */
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+	max_align_t data[];
+};
+
+struct arena {
+	struct arena_chunk *chunks;
+};
+
+void arena_init(struct arena *a);
+void *arena_alloc(struct arena *a, size_t size);
+void arena_free(struct arena *a);
 char *strbase(const char *path);
 char *get_kern_prop_value(const char *buf, const char *prop, size_t *len);
 int match_kern_prop_value(const char *buf, const char *prop, const char *value);
-int socket_connect(const char *path);
-ssize_t socket_readline(int fd, char *buf, size_t len);
-int path_to_fd(const char *path);
+int socket_connect(const char *path, int type);
+void socket_buf_init(struct socket_buf *sb, int type);
+ssize_t socket_readlines(int fd, struct socket_buf *sb, line_cb_t cb,
+    void *args);
+int scan_fds(fd_cb_t cb, void *args);
 int scandir_recursive(char *path, size_t len, struct scan_ctx *ctx);
 #ifdef HAVE_DEVINFO_H
 int scandev_recursive(struct scan_ctx *ctx);
@@ -68,5 +112,8 @@ int pipe2(int fildes[2], int flags);
 #ifndef HAVE_STRCHRNUL
 char *strchrnul(const char *p, int ch);
 #endif
+#ifndef HAVE_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t dsize);
+#endif
 
 #endif /* UTILS_H_ */